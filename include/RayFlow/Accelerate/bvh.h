@@ -81,6 +81,25 @@ public:
 
     rstd::optional<ShapeIntersection> Intersect(const Ray& ray, Float tMax = Infinity) const;
     
+    // any hit before tMax, traversal stops at the first one
+    bool IntersectP(const Ray& ray, Float tMax = Infinity) const;
+    
+    static constexpr int PacketSize = 16;
+
+    // any hit test of up to PacketSize rays traversing the tree together, a node is visited once for all
+    // the rays that reach it and rays leave the packet at their first hit. Rays with the same direction
+    // signs share most of their nodes. occluded[i] is set for the rays hitting something before tMax[i]
+    void IntersectP(const Ray* rays, const Float* tMax, int count, bool* occluded) const;
+    
+    AABB3 Bounds() const {
+        return mNodes_.empty() ? AABB3() : mNodes_[0].bounds;
+    }
+    
+    // index of a primitive an intersection points to, stable for a given scene
+    int PrimitiveIndex(const Primitive* primitive) const {
+        return int(primitive - mOrderedPrimitives_.data());
+    }
+    
 private:
 
     BVHBuildNode* BuildBVH(const std::vector<Primitive>& primitives, 
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <RayFlow/Util/vecmath.h>
+#include <RayFlow/Util/atomic_float.h>
+#include <RayFlow/Core/spectrum.h>
+
+#include <atomic>
+#include <vector>
+
+namespace rayflow {
+
+// world space cache of the outgoing radiance of diffuse surfaces. Cells are the voxels of a hashed grid,
+// split by the dominant axis of the normal so the two sides of a wall stay apart. All threads insert
+// cells and accumulate samples concurrently without locks. Samples keep accumulating over the whole render
+// as long as callers keep adding them, also for cells that already answer lookups
+class RadianceCache {
+public:
+    // a cell answers lookups once it holds minSamples samples, larger cells and fewer samples trade
+    // variance for bias. capacity is rounded up to a power of two
+    RadianceCache(Float cellSize, int minSamples, int capacity = 1 << 20);
+
+    bool Lookup(const Point3& p, const Normal3& n, Spectrum* L) const;
+
+    void AddSample(const Point3& p, const Normal3& n, const Spectrum& L);
+
+private:
+    struct Cell {
+        // 0 marks an empty slot
+        std::atomic<uint64_t> key{ 0 };
+        AtomicFloat radiance[3];
+        std::atomic<int> count{ 0 };
+    };
+
+    uint64_t Key(const Point3& p, const Normal3& n) const;
+
+    // slot of key, -1 if it is not in the table
+    int Find(uint64_t key) const;
+
+    // slot of key, claimed if it is not in the table yet, -1 when the probe sequence is full
+    int Insert(uint64_t key);
+
+    static constexpr int MaxProbes = 32;
+
+    Float mInvCellSize_;
+    int mMinSamples_;
+    uint64_t mMask_;
+    std::vector<Cell> mCells_;
+};
+
+}
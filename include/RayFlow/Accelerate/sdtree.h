@@ -0,0 +1,173 @@
+#pragma once
+
+#include <RayFlow/Util/vecmath.h>
+#include <RayFlow/Util/atomic_float.h>
+#include <RayFlow/Util/rng.h>
+#include <RayFlow/Std/vector.h>
+
+#include <atomic>
+#include <vector>
+
+namespace rayflow {
+
+// Spatial-directional radiance cache from "Practical Path Guiding for Efficient Light-Transport Simulation"
+// (Muller et al. 2017). A binary tree over space stores in every leaf a quadtree over the
+// cylindrical parameterization of the sphere of directions.
+
+// direction <-> [0, 1)^2, the mapping preserves area so the jacobian is a constant 1 / 4pi
+RAYFLOW_CPU_GPU inline Point2 DirectionToCylindrical(const Vector3& d) {
+    Float cosTheta = Clamp(d.z, -1, 1);
+    Float phi = std::atan2(d.y, d.x);
+
+    if (phi < 0) {
+        phi += 2 * Pi;
+    }
+
+    return Point2(Clamp((cosTheta + 1) * 0.5f, 0, OneMinusEpsilon),
+                  Clamp(phi * Inv2Pi, 0, OneMinusEpsilon));
+}
+
+RAYFLOW_CPU_GPU inline Vector3 CylindricalToDirection(const Point2& p) {
+    Float cosTheta = 2 * p.x - 1;
+    Float sinTheta = SafeSqrt(1 - cosTheta * cosTheta);
+    Float phi = 2 * Pi * p.y;
+
+    return Vector3(::cos(phi) * sinTheta, ::sin(phi) * sinTheta, cosTheta);
+}
+
+struct DTreeNode {
+    DTreeNode() {
+        for (int i = 0; i < 4; ++i) {
+            children[i] = 0;
+        }
+    }
+
+    DTreeNode(const DTreeNode& other) {
+        for (int i = 0; i < 4; ++i) {
+            sums[i] = float(other.sums[i]);
+            children[i] = other.children[i];
+        }
+    }
+
+    DTreeNode& operator=(const DTreeNode& other) {
+        for (int i = 0; i < 4; ++i) {
+            sums[i] = float(other.sums[i]);
+            children[i] = other.children[i];
+        }
+        return *this;
+    }
+
+    RAYFLOW_CPU_GPU bool IsLeaf(int quadrant) const { return children[quadrant] == 0; }
+
+    RAYFLOW_CPU_GPU Float Sum() const { return sums[0] + sums[1] + sums[2] + sums[3]; }
+
+    // quadrant containing p, p is remapped into the quadrant's local [0, 1)^2
+    RAYFLOW_CPU_GPU static int ChildIndex(Point2& p) {
+        int idx = 0;
+        for (int i = 0; i < 2; ++i) {
+            if (p[i] < 0.5f) {
+                p[i] *= 2;
+            }
+            else {
+                p[i] = (p[i] - 0.5f) * 2;
+                idx |= 1 << i;
+            }
+        }
+        return idx;
+    }
+
+    // radiance energy of each quadrant, accumulated concurrently while training
+    AtomicFloat sums[4];
+    // index of the child node in DTree::mNodes_, 0 marks a leaf quadrant
+    int children[4];
+};
+
+class DTree {
+public:
+    DTree() : mNodes_(1), mSampleWeight_(0) {
+
+    }
+
+    DTree(const DTree& other) :
+        mNodes_(other.mNodes_),
+        mSampleWeight_(float(other.mSampleWeight_)) {
+
+    }
+
+    DTree& operator=(const DTree& other) {
+        mNodes_ = other.mNodes_;
+        mSampleWeight_ = float(other.mSampleWeight_);
+        return *this;
+    }
+
+    RAYFLOW_CPU_GPU Float Total() const { return mNodes_[0].Sum(); }
+
+    RAYFLOW_CPU_GPU Float SampleWeight() const { return mSampleWeight_; }
+
+    RAYFLOW_CPU_GPU int NodeCount() const { return mNodes_.size(); }
+
+    void ScaleSampleWeight(Float scale) { mSampleWeight_ = mSampleWeight_ * scale; }
+
+    // thread safe, the topology is fixed during a pass
+    void Record(const Vector3& d, Float irradiance, Float weight);
+
+    Float Pdf(const Vector3& d) const;
+
+    Vector3 Sample(Point2 u) const;
+
+    // a tree with the same energy-driven subdivision as this one and cleared statistics,
+    // quadrants holding more than rho of the total energy are split up to maxDepth
+    DTree Refined(Float rho, int maxDepth) const;
+
+private:
+    std::vector<DTreeNode> mNodes_;
+    AtomicFloat mSampleWeight_;
+};
+
+struct DTreeWrapper {
+    // read-only during a pass, learned in the previous one
+    DTree sampling;
+    // receives the radiance of the current pass
+    DTree building;
+
+    void Record(const Vector3& d, Float irradiance, Float weight) {
+        building.Record(d, irradiance, weight);
+    }
+
+    Float Pdf(const Vector3& d) const {
+        return sampling.Pdf(d);
+    }
+
+    Vector3 Sample(const Point2& u) const {
+        return sampling.Sample(u);
+    }
+};
+
+struct STreeNode {
+    bool isLeaf = true;
+    int axis = 0;
+    int children[2] = { -1, -1 };
+    int dTreeIndex = -1;
+};
+
+class SDTree {
+public:
+    SDTree(const AABB3& bounds);
+
+    DTreeWrapper* Lookup(const Point3& p);
+
+    // split spatial leaves that collected more than spatialThreshold samples, then promote the
+    // building trees to sampling trees and refine their directional subdivision
+    void Refine(Float spatialThreshold, Float rho = 0.01f, int maxDepth = 20);
+
+    int LeafCount() const { return mDTrees_.size(); }
+
+private:
+    void Subdivide(int nodeIndex);
+
+    AABB3 mBounds_;
+    std::vector<STreeNode> mNodes_;
+    std::vector<DTreeWrapper> mDTrees_;
+};
+
+}
@@ -6,11 +6,24 @@
 
 namespace rayflow {
 
+// film auxiliary features of a camera ray's first hit at distance depth, the albedo is a one sample estimate
+AOVSample FirstHitAOVs(const Scene& scene, const SurfaceIntersection& si, Float depth, Sampler& sampler);
+
+// scale of the camera ray differentials of a pixel taking samplesPerPixel samples, the texture footprint
+// of a sample shrinks with the number of samples in the pixel
+Float CameraRayDifferentialScale(size_t samplesPerPixel);
+
 class Integrator {
 public:
     virtual ~Integrator() = default;
     
     virtual void Render(const Scene& scene) = 0;
+
+    // whether camera samples may importance sample the film's filter, see Film::SetFilterSampling
+    virtual bool SupportsFilterSampling() const { return false; }
+
+    // whether the integrator adds splats anywhere on the film, which a streaming film can not bound
+    virtual bool Splats() const { return false; }
 };
 
 class SamplingIntegrator : public Integrator {
@@ -24,12 +37,23 @@ public:
     virtual void Preprocess(const Scene& scene, Sampler& sampler) {}
 
     virtual void Render(const Scene& scene);
+
+    // RenderTile samples the filter, integrators with a Render of their own do not
+    bool SupportsFilterSampling() const override { return true; }
     
     virtual Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler) const {
         return Spectrum(0.f);
     }
 
 protected:
+    // renders sampleCount samples per pixel into the film without writing it, passIndex decorrelates
+    // the sampler seeds of consecutive passes
+    void RenderPass(const Scene& scene, int passIndex, size_t sampleCount);
+
+    // renders sampleCount samples for every pixel of pixelBounds, seed is the seed sampler was cloned with
+    virtual void RenderTile(const Scene& scene, Sampler& sampler, FilmTile* filmTile,
+                            const AABB2i& pixelBounds, size_t sampleCount, uint64_t seed);
+
     Camera* mCamera_;
     Sampler* mSampler_;
 };
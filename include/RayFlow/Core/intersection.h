@@ -69,8 +69,18 @@ public:
 
     RAYFLOW_CPU_GPU const AreaLight* GetAreaLight() const;
 
+    // screen space derivatives of uv from the differentials of the ray that found the hit, "Tracing
+    // Ray Differentials" (Igehy 1999). Without differentials they stay 0 and textures use their finest level
+    RAYFLOW_CPU_GPU void ComputeDifferentials(const Ray& ray);
+
     Normal3 ns;
     const Primitive* primitive = nullptr;
+    Vector3 dpdu;
+    Vector3 dpdv;
+    Float dudx = 0;
+    Float dvdx = 0;
+    Float dudy = 0;
+    Float dvdy = 0;
 };
 
 }
\ No newline at end of file
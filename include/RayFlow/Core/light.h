@@ -80,5 +80,7 @@ public:
     const Transform* mWorldToLocal_;
     const Transform* mLocalToWorld_;
     LightType type;
+    // position in the scene light list, assigned by the LightSampler
+    int index = -1;
 };
 }
\ No newline at end of file
@@ -10,7 +10,20 @@ public:
 	Ray(const Point3& p, const Vector3& d) : o(p), d(d) {}
 	Point3 operator()(Float t) const { return o + t * d; }
 
+	// shrinks the footprint of the differentials, for pixels that take several samples
+	void ScaleDifferentials(Float s) {
+		rxOrigin = o + (rxOrigin - o) * s;
+		ryOrigin = o + (ryOrigin - o) * s;
+		rxDirection = d + (rxDirection - d) * s;
+		ryDirection = d + (ryDirection - d) * s;
+	}
+
 	Point3 o;
 	Vector3 d;
+
+	// rays through the neighboring pixels, cameras set them so hits can filter their textures
+	bool hasDifferentials = false;
+	Point3 rxOrigin, ryOrigin;
+	Vector3 rxDirection, ryDirection;
 };
 }
\ No newline at end of file
@@ -92,6 +92,12 @@ public:
 
     virtual Sampler* Clone(uint64_t seed) = 0;
 
+    // clone for a tile of one of several passes over the same pixels, like the passes of a progressive render
+    // or the iterations of photon mapping. Samplers whose clones ignore the seed decorrelate the passes here
+    virtual Sampler* ClonePass(uint64_t seed, int) {
+        return Clone(seed);
+    }
+
     RAYFLOW_CPU_GPU virtual void StartPixel(const Point2i& pos) {
         mCurrentPixel = pos;
         mCurrentSampleIndex_ = 0;
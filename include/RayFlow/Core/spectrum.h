@@ -36,6 +36,8 @@ static const Float CIE_Y_integral = 106.856895;
 template <int N>
 class TSpectrum {
 public:
+    static constexpr int nSamples = N;
+
     TSpectrum(Float val = 0.0f) {
         for (int i = 0; i < N; ++i) { values[i] = val; }
     }
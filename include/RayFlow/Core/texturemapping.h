@@ -9,6 +9,9 @@ public:
     RAYFLOW_CPU_GPU virtual ~TextureMapping() = default;
 
     RAYFLOW_CPU_GPU virtual Point2 Map(const Intersection& isect) const = 0;
+
+    // st together with its screen space derivatives, used to size texture filter footprints
+    RAYFLOW_CPU_GPU virtual Point2 Map(const SurfaceIntersection& isect, Vector2* dstdx, Vector2* dstdy) const = 0;
 };
 
 
@@ -17,7 +17,8 @@ namespace rayflow
     public:
         RayFlowEngine() = default;
 
-        bool Init(const std::string &filename);
+        // a non-empty integratorType replaces the integrator of the scene file
+        bool Init(const std::string &filename, const std::string &integratorType = "");
 
         void Render();
 
@@ -61,6 +62,20 @@ namespace rayflow
             return mImages_[name];
         }
 
+        // images are paged in through the texture cache once it is set instead of being decoded up front
+        void SetTextureCache(TextureCache *cache)
+        {
+            mTextureCache_ = cache;
+        }
+
+        void AddMIPMap(const std::string &name, MIPMap *mipmap)
+        {
+            mMIPMaps_[name] = mipmap;
+        }
+
+        // the pyramid of an image is built on first use and shared by every texture reading it
+        MIPMap *GetMIPMap(const std::string &name, const std::string &filename);
+
     private:
         bool ReadScene(const std::string &configFileName);
 
@@ -84,6 +99,8 @@ namespace rayflow
 
     private:
         std::unordered_map<std::string, BitMap *> mImages_;
+        std::unordered_map<std::string, MIPMap *> mMIPMaps_;
+        TextureCache *mTextureCache_ = nullptr;
         std::unordered_map<std::string, TriangleMeshObject *> mMeshObjects_;
         Allocator mAlloc_;
 
@@ -1,15 +1,23 @@
 #include <RayFlow/Util/vecmath.h>
 #include <RayFlow/Render/bxdfs.h>
 #include <RayFlow/Render/cameras.h>
+#include <RayFlow/Render/denoiser.h>
 #include <RayFlow/Render/film.h>
 #include <RayFlow/Render/filters.h>
 #include <RayFlow/Render/lights.h>
 #include <RayFlow/Render/light_sampler.h>
 #include <RayFlow/Render/materials.h>
+#include <RayFlow/Render/reservoir.h>
 #include <RayFlow/Render/samplers.h>
 #include <RayFlow/Render/scene.h>
 #include <RayFlow/Render/shapes.h>
+#include <RayFlow/Render/texturecache.h>
 #include <RayFlow/Render/textures.h>
 #include <RayFlow/Integrators/direct.h>
 #include <RayFlow/Integrators/pt.h>
-#include <RayFlow/Integrators/bdpt.h>
\ No newline at end of file
+#include <RayFlow/Integrators/bdpt.h>
+#include <RayFlow/Integrators/guided.h>
+#include <RayFlow/Integrators/mlt.h>
+#include <RayFlow/Integrators/preview.h>
+#include <RayFlow/Integrators/sppm.h>
+#include <RayFlow/Integrators/vcm.h>
\ No newline at end of file
@@ -1,4 +1,6 @@
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <tinyxml2/tinyxml2.h>
@@ -13,8 +15,10 @@ class RayFlowEngine;
 
 class ConfigFileParser {
 public:
-    ConfigFileParser(RayFlowEngine* engine) :
-        engine(engine) {
+    // a non-empty integratorType replaces the integrator of the scene file
+    ConfigFileParser(RayFlowEngine* engine, const std::string& integratorType = "") :
+        engine(engine),
+        integratorOverride(integratorType) {
 
     }
     
@@ -112,6 +116,38 @@ private:
         }
     }
 
+    // optional <default name="..." value="..."/> entry, nullptr if absent
+    const char* FindDefault(tinyxml2::XMLElement* sceneNode, const char* name) const {
+        for (tinyxml2::XMLElement* node = sceneNode->FirstChildElement("default"); node; node = node->NextSiblingElement("default")) {
+            const char* nodeName = node->Attribute("name");
+            if (nodeName && strcmp(nodeName, name) == 0) {
+                return node->Attribute("value");
+            }
+        }
+        return nullptr;
+    }
+
+    template<typename T>
+    T FindDefaultNumber(tinyxml2::XMLElement* sceneNode, const char* name, T fallback) const {
+        const char* text = FindDefault(sceneNode, name);
+        return text ? ParseNumber<T>(text) : fallback;
+    }
+
+    LightSamplerType ParseLightSamplerType(const char* text) const {
+        if (text == nullptr || strcmp(text, "uniform") == 0) {
+            return LightSamplerType::Uniform;
+        }
+        else if (strcmp(text, "power") == 0) {
+            return LightSamplerType::Power;
+        }
+        else if (strcmp(text, "alias") == 0) {
+            return LightSamplerType::Alias;
+        }
+
+        std::cout << "ERROR::Unspported light sampler [ " << text << "], use uniform\n";
+        return LightSamplerType::Uniform;
+    }
+
     Texture<Spectrum>* ParseRGBTexture(tinyxml2::XMLElement* node) const {
         Texture<Spectrum>* tex = nullptr;
 
@@ -121,15 +157,8 @@ private:
         }
         else {
             std::string texname = node->FirstChildElement("string")->Attribute("value");
-            BitMap* bitmap = engine->GetBitMap(texname);
-
-            if (bitmap == nullptr) {
-                bitmap = engine->mAlloc_.new_object<BitMap>(assetPath + texname, false);
-                engine->AddBitMap(texname, bitmap);
-            }
-
             TextureMapping* mapping = engine->mAlloc_.new_object<UVMapping>();
-            tex = engine->mAlloc_.new_object<ImageTexture<Spectrum>>(mapping, bitmap);
+            tex = engine->mAlloc_.new_object<ImageTexture<Spectrum>>(mapping, engine->GetMIPMap(texname, assetPath + texname));
         }
         
         return tex;
@@ -147,8 +176,28 @@ private:
     }
 
 private:
+    // an OBJ file is decoded once however many shapes reference it. All its groups share one vertex pool
+    struct ObjAsset {
+        std::vector<Point3> positions;
+        std::vector<Normal3> normals;
+        std::vector<Point2> texCoords;
+        // position, normal and texcoord index of every face vertex
+        std::vector<int> fid;
+        std::string warning;
+        std::string error;
+        bool loaded = false;
+    };
+
+    // collects the OBJ files and texture images of the scene and decodes them concurrently, images are
+    // left to the texture cache when there is one
+    void LoadAssets(tinyxml2::XMLElement* sceneNode);
+
+    static void ConvertObj(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, ObjAsset& asset);
+
     RayFlowEngine* engine;
     std::string assetPath;
+    std::unordered_map<std::string, std::unique_ptr<ObjAsset>> objAssets;
+    std::string integratorOverride;
 };
 
 }
\ No newline at end of file
@@ -18,6 +18,11 @@ inline Float CorrectNonsymmetryCauseByShadingNormal(const SurfaceIntersection& s
     }
 }
 
+// ratio of the reverse and forward area pdfs of a vertex, a zero pdf stands for a delta density
+inline Float PdfRatio(Float pdfBwd, Float pdfFwd) {
+    return (pdfBwd > 0 ? pdfBwd : 1) / (pdfFwd > 0 ? pdfFwd : 1);
+}
+
 class Vertex {
 public:
     enum class VertexType {
@@ -213,6 +218,9 @@ public:
     Spectrum alpha;
     Float pdfFwd = 0;
     Float pdfBwd = 0;
+    // MIS ratio sum of the strategies that split the subpath at or before this vertex,
+    // valid once pdfBwd is set
+    Float misSum = 0;
     SurfaceIntersection si;
     bool delta = false;
     const Camera* camera = nullptr;
@@ -220,43 +228,6 @@ public:
     BSDF bsdf;
 };
 
-template <typename T>
-class BackUp {
-public:
-    BackUp() : mPtr_(nullptr) {
-
-    }
-
-    BackUp(T* ptr, T value = T()) :
-        mPtr_(ptr) {
-        if (mPtr_) {
-            mBackUpData_ = *mPtr_;
-            *mPtr_ = value;
-        }
-    }
-
-    ~BackUp() {
-        if (mPtr_) {
-            *mPtr_ = mBackUpData_;
-        }
-    }
-
-    BackUp(const BackUp &) = delete;
-    BackUp& operator=(const BackUp &) = delete;
-    BackUp& operator=(BackUp &&other) {
-        if (mPtr_) {
-            *mPtr_ = mBackUpData_;
-        }
-        mPtr_ = other.mPtr_;
-        mBackUpData_ = other.mBackUpData_;
-        other.mPtr_ = nullptr;
-        return *this;
-    }
-private:
-    T mBackUpData_;
-    T* mPtr_;
-};
-
 inline bool Visable(const Scene& scene, const SurfaceIntersection& p0, const SurfaceIntersection& p1) {
     Float dist2 = DistanceSquare(p0.p, p1.p);
 
@@ -265,7 +236,7 @@ inline bool Visable(const Scene& scene, const SurfaceIntersection& p0, const Sur
     }
 
     Ray ray = p0.SpawnRayTo(p1.p);
-    if (scene.Intersect(ray, ::sqrt(dist2) - ShadowEpsilon)) {
+    if (scene.IntersectP(ray, ::sqrt(dist2) - ShadowEpsilon)) {
         return false;
     }
 
@@ -280,36 +251,96 @@ inline Float G(const Scene& scene, const SurfaceIntersection& p0, const SurfaceI
     }
 
     Ray ray = p0.SpawnRayTo(p1.p);
-    if (scene.Intersect(ray, ::sqrt(dist2) - ShadowEpsilon)) {
+    if (scene.IntersectP(ray, ::sqrt(dist2) - ShadowEpsilon)) {
+        return 0;
+    }
+
+    return AbsDot(p0.ns, ray.d) * AbsDot(p1.ns, ray.d) / dist2;
+}
+
+// G without the visibility test
+inline Float GeometryTerm(const SurfaceIntersection& p0, const SurfaceIntersection& p1) {
+    Float dist2 = DistanceSquare(p0.p, p1.p);
+
+    if (dist2 == 0) {
         return 0;
     }
 
+    Ray ray = p0.SpawnRayTo(p1.p);
     return AbsDot(p0.ns, ray.d) * AbsDot(p1.ns, ray.d) / dist2;
 }
 
+// the segment Visable would trace, false when the endpoints coincide
+inline bool ConnectionShadowRay(const SurfaceIntersection& p0, const SurfaceIntersection& p1, ShadowRay* shadowRay) {
+    Float dist2 = DistanceSquare(p0.p, p1.p);
+
+    if (dist2 == 0) {
+        return false;
+    }
+
+    shadowRay->ray = p0.SpawnRayTo(p1.p);
+    shadowRay->tMax = ::sqrt(dist2) - ShadowEpsilon;
+    shadowRay->occluded = false;
+    return true;
+}
+
 class BDPTIntegrator : public MonteCarloIntegrator {
 public:
+    // lightPathConnections > 0 connects every camera subpath to that many light subpaths drawn
+    // from a pool shared by the pixels of a tile, 0 traces a fresh light subpath per sample.
+    // Connections dimmer than shadowRRThreshold play russian roulette before their shadow ray
     BDPTIntegrator(Camera* camera, Sampler* sampler, 
                    int maxDepth = 8, 
-                   bool strictNormal = false) :
-        MonteCarloIntegrator(camera, sampler, maxDepth, -1, strictNormal) {
+                   bool strictNormal = false,
+                   int lightPathConnections = 0,
+                   Float shadowRRThreshold = 0) :
+        MonteCarloIntegrator(camera, sampler, maxDepth, -1, strictNormal),
+        mLightPathConnections_(lightPathConnections),
+        mShadowRRThreshold_(shadowRRThreshold) {
 
     }
 
     virtual void Render(const Scene& scene);
 
+    bool SupportsFilterSampling() const override { return false; }
+
+    bool Splats() const override { return true; }
+
 private:
+    // the Metropolis integrator evaluates single strategies through the subpath construction and ConnectPath
+    friend class MLTIntegrator;
+
     using Path = std::vector<Vertex>;
     
-    int ConstructCameraPath(const Scene& scene, Sampler& sampler, const Point2& pFilm, Path& path) const;
+    // unoccluded contribution of a connection waiting for its shadow ray
+    struct PendingConnection {
+        Spectrum L;
+        Point2 pFilm;
+        bool splat;
+    };
+    
+    // maxDepth < 0 walks up to the integrator's max depth, the camera ray differentials are scaled by differentialScale
+    int ConstructCameraPath(const Scene& scene, Sampler& sampler, const Point2& pFilm, Path& path, int maxDepth = -1,
+                            Float differentialScale = 1) const;
+
+    int ConstructLightPath(const Scene& scene, Sampler& sampler, Vertex* path, int maxDepth = -1) const;
 
-    int ConstructLightPath(const Scene& scene, Sampler& sampler, Path& path) const;
+    // with shadowRay set the visibility test is left to the caller, which traces shadowRay
+    Spectrum ConnectPath(const Scene& scene, Sampler& sampler, const Vertex* cameraPath, const Vertex* lightPath, int t, int s, Point2* pFilm,
+                         ShadowRay* shadowRay = nullptr) const;
 
-    Spectrum ConnectPath(const Scene& scene, Sampler& sampler, Path& cameraPath, Path& lightPath, int t, int s, Point2* pFilm) const;
+    int RandomWalk(const Scene& scene, Sampler& sampler, Ray ray, Spectrum alpha, Float pdfDir, Vertex* path, TransportMode mode,
+                   int maxDepth = -1) const;
 
-    int RandomWalk(const Scene& scene, Sampler& sampler, Ray ray, Spectrum alpha, Float pdfDir, Path& path, TransportMode mode) const;
+    Float MIS(const Scene& scene, const Vertex* cameraPath, const Vertex* lightPath, const Vertex& vSample, int s, int t) const;
+
+    // number of times strategy (s, t) is evaluated per camera subpath, relative to the others
+    Float StrategyCount(int s, int t) const {
+        return (mLightPathConnections_ > 1 && s > 1 && t > 1) ? mLightPathConnections_ : 1;
+    }
 
-    Float MIS(const Scene& scene, Path& cameraPath, Path& lightPath, Vertex& vSample, int s, int t) const;
+    int mLightPathConnections_;
+    Float mShadowRRThreshold_;
 };
 
 
@@ -5,12 +5,35 @@ namespace rayflow {
 
 class DirectIntegrator : public SamplingIntegrator {
 public:
-    DirectIntegrator(Camera* camera, Sampler* sampler) :
-        SamplingIntegrator(camera, sampler) {
+    DirectIntegrator(Camera* camera, Sampler* sampler,
+                     int lightCandidates = 0, int spatialNeighbors = 0) :
+        SamplingIntegrator(camera, sampler),
+        mLightCandidates_(lightCandidates),
+        mSpatialNeighbors_(spatialNeighbors) {
 
     }
 
     virtual Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler) const;
+
+    // the spatial reuse sweeps splat their samples with the filter
+    bool SupportsFilterSampling() const override {
+        return mLightCandidates_ <= 0 || mSpatialNeighbors_ <= 0;
+    }
+
+protected:
+    // with spatial reuse every sample index of the tile is shaded in three sweeps: primary hits and
+    // candidate reservoirs, reservoir reuse between neighboring pixels, shadow rays
+    void RenderTile(const Scene& scene, Sampler& sampler, FilmTile* filmTile,
+                    const AABB2i& pixelBounds, size_t sampleCount, uint64_t seed) override;
+
+private:
+    // light candidates resampled per shading point, 0 uses a single light sample with BSDF MIS
+    int mLightCandidates_;
+
+    // reservoirs of other pixels in the tile merged into each pixel's reservoir
+    int mSpatialNeighbors_;
+
+    static constexpr int SpatialRadius = 5;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include <RayFlow/Core/integrator.h>
+#include <RayFlow/Accelerate/sdtree.h>
+
+#include <memory>
+
+namespace rayflow {
+
+// path tracer whose continuation directions are drawn from a mixture of the BSDF and an
+// SD-tree learned online during the first, progressively doubling passes
+class GuidedPathTracerIntegrator : public MonteCarloIntegrator {
+public:
+    GuidedPathTracerIntegrator(Camera* camera, Sampler* sampler,
+                               int maxDepth = 8, int rrDepth = 3,
+                               bool strictNormal = false,
+                               Float bsdfSamplingFraction = 0.5f) :
+        MonteCarloIntegrator(camera, sampler, maxDepth, rrDepth, strictNormal),
+        mBSDFSamplingFraction_(bsdfSamplingFraction) {
+
+    }
+
+    void Render(const Scene& scene) override;
+
+    virtual Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler) const;
+
+private:
+    struct GuidedVertex {
+        DTreeWrapper* dTree;
+        Vector3 wi;
+        Spectrum throughput;
+        Spectrum radiance;
+        Float woPdf;
+    };
+
+    static constexpr int MaxGuidedVertices = 32;
+
+    // c in the spatial split threshold c * sqrt(spp of the pass)
+    static constexpr Float SpatialThreshold = 12000;
+
+    // probability of using the BSDF instead of the SD-tree once guiding is enabled
+    Float mBSDFSamplingFraction_;
+
+    std::unique_ptr<SDTree> mSDTree_;
+
+    // record radiance into the building trees
+    bool mTraining_ = false;
+
+    // sample from the sampling trees
+    bool mGuiding_ = false;
+};
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <RayFlow/Integrators/bdpt.h>
+
+namespace rayflow {
+
+// a point of primary sample space that a Markov chain mutates, "A simple and robust mutation strategy
+// for the Metropolis light transport algorithm" (Kelemen et al. 2002). Samples are drawn lazily and
+// interleaved over streamCount streams, so every stream keeps its own dimensions whatever the others consume
+class MLTSampler : public Sampler {
+public:
+    MLTSampler(uint64_t seed, Float sigma, Float largeStepProbability, int streamCount) :
+        Sampler(1),
+        rng(seed),
+        mSigma_(sigma),
+        mLargeStepProbability_(largeStepProbability),
+        mStreamCount_(streamCount) {
+
+    }
+
+    RAYFLOW_CPU_GPU Sampler* Clone(uint64_t seed) final;
+
+    RAYFLOW_CPU_GPU Float Get1D() final;
+
+    RAYFLOW_CPU_GPU Point2 Get2D() final;
+
+    // proposes the next state, either fresh uniform samples or a small perturbation of the current ones
+    void StartIteration();
+
+    void Accept();
+
+    // restores the samples the rejected proposal modified
+    void Reject();
+
+    void StartStream(int index) {
+        mStreamIndex_ = index;
+        mSampleIndex_ = 0;
+    }
+
+public:
+    Rng rng;
+
+private:
+    struct PrimarySample {
+        Float value = 0;
+        // iteration of the last change, samples untouched since a large step are drawn again on use
+        int64_t lastModificationIteration = 0;
+        Float valueBackup = 0;
+        int64_t modifyBackup = 0;
+
+        void Backup() {
+            valueBackup = value;
+            modifyBackup = lastModificationIteration;
+        }
+
+        void Restore() {
+            value = valueBackup;
+            lastModificationIteration = modifyBackup;
+        }
+    };
+
+    // brings sample index up to the current iteration
+    void EnsureReady(int index);
+
+    Float mSigma_;
+    Float mLargeStepProbability_;
+    int mStreamCount_;
+    std::vector<PrimarySample> mSamples_;
+    int64_t mCurrentIteration_ = 0;
+    bool mLargeStep_ = true;
+    int64_t mLastLargeStepIteration_ = 0;
+    int mStreamIndex_ = 0;
+    int mSampleIndex_ = 0;
+};
+
+// primary sample space Metropolis light transport over the BDPT strategies, "Multiplexed Metropolis
+// Light Transport" (Hachisuka et al. 2014). Every chain keeps a fixed path depth and mutates the choice
+// of strategy together with the subpaths, the contribution of a state is a single BDPT ConnectPath
+class MLTIntegrator : public MonteCarloIntegrator {
+public:
+    // mutationsPerPixel mutations per pixel are spread over chainCount chains, whose start states are
+    // picked among bootstrapSamples paths per depth
+    MLTIntegrator(Camera* camera, Sampler* sampler, int mutationsPerPixel,
+                  int maxDepth = 8, int bootstrapSamples = 100000, int chainCount = 1000,
+                  Float sigma = 0.01f, Float largeStepProbability = 0.3f) :
+        MonteCarloIntegrator(camera, sampler, maxDepth, -1),
+        mBDPT_(camera, sampler, maxDepth),
+        mMutationsPerPixel_(mutationsPerPixel),
+        mBootstrapSamples_(bootstrapSamples),
+        mChainCount_(chainCount),
+        mSigma_(sigma),
+        mLargeStepProbability_(largeStepProbability) {
+
+    }
+
+    virtual void Render(const Scene& scene);
+
+    bool SupportsFilterSampling() const override { return false; }
+
+    bool Splats() const override { return true; }
+
+private:
+    static constexpr int CameraStreamIndex = 0;
+    static constexpr int LightStreamIndex = 1;
+    static constexpr int ConnectionStreamIndex = 2;
+    static constexpr int StreamCount = 3;
+
+    // contribution of the state of sampler among the paths with depth segments, pRaster receives its film position
+    Spectrum L(const Scene& scene, MLTSampler& sampler, int depth, Point2* pRaster,
+               std::vector<Vertex>& cameraPath, std::vector<Vertex>& lightPath) const;
+
+    BDPTIntegrator mBDPT_;
+    int mMutationsPerPixel_;
+    int mBootstrapSamples_;
+    int mChainCount_;
+    Float mSigma_;
+    Float mLargeStepProbability_;
+};
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <RayFlow/Core/integrator.h>
+
+namespace rayflow {
+
+enum class PreviewMode {
+    AmbientOcclusion,
+    Albedo,
+    Normal,
+    // one light sample at the primary hit
+    Direct,
+    // direct lighting at the primary hit and at one BSDF sampled bounce
+    OneBounce
+};
+
+// cheap look-dev integrators, light reaches a point only through light sampling so every
+// visibility test is an occlusion-only query
+class PreviewIntegrator : public SamplingIntegrator {
+public:
+    // occluders farther than aoDistance are ignored, aoDistance <= 0 counts all of them
+    PreviewIntegrator(Camera* camera, Sampler* sampler, PreviewMode mode, Float aoDistance = 0) :
+        SamplingIntegrator(camera, sampler),
+        mMode_(mode),
+        mAODistance_(aoDistance) {
+
+    }
+
+    virtual Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler) const;
+
+private:
+    Spectrum AmbientOcclusion(const Scene& scene, const SurfaceIntersection& si, Sampler& sampler) const;
+
+    Spectrum DirectLighting(const Scene& scene, const SurfaceIntersection& si, const BSDF& bsdf, Sampler& sampler) const;
+
+    PreviewMode mMode_;
+    Float mAODistance_;
+};
+
+}
@@ -1,18 +1,42 @@
 #pragma once
 #include <RayFlow/Core/integrator.h>
+#include <RayFlow/Accelerate/radiance_cache.h>
+
+#include <memory>
 
 namespace rayflow {
 
 class PathTracerIntegrator : public MonteCarloIntegrator {
 public:
+    // cacheMinSamples > 0 ends paths after their second non-specular bounce in a radiance cache,
+    // cacheCellSize <= 0 derives the cell size from the scene size
     PathTracerIntegrator(Camera* camera, Sampler* sampler, 
                          int maxDepth = 8, int rrDepth = 3, 
-                         bool strictNormal = false) :
-        MonteCarloIntegrator(camera, sampler, maxDepth, rrDepth, strictNormal) {
+                         bool strictNormal = false, int lightCandidates = 0,
+                         int cacheMinSamples = 0, Float cacheCellSize = 0) :
+        MonteCarloIntegrator(camera, sampler, maxDepth, rrDepth, strictNormal),
+        mLightCandidates_(lightCandidates),
+        mCacheMinSamples_(cacheMinSamples),
+        mCacheCellSize_(cacheCellSize) {
 
     }
 
+    void Preprocess(const Scene& scene, Sampler& sampler) override;
+
     virtual Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler) const;
+
+private:
+    // light candidates resampled per vertex, 0 uses a single light sample with BSDF MIS
+    int mLightCandidates_;
+
+    int mCacheMinSamples_;
+    Float mCacheCellSize_;
+    std::unique_ptr<RadianceCache> mRadianceCache_;
+
+    // cache candidates along one path
+    static constexpr int MaxCacheRecords = 16;
+    // fraction of cache hits that continue the path and sample the cell again
+    static constexpr Float CacheRefreshProbability = 0.1f;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include <RayFlow/Core/integrator.h>
+#include <RayFlow/Util/atomic_float.h>
+
+#include <atomic>
+
+namespace rayflow {
+
+// stochastic progressive photon mapping, "Stochastic Progressive Photon Mapping" (Hachisuka and Jensen 2009)
+class SPPMIntegrator : public MonteCarloIntegrator {
+public:
+    // iterations camera and photon passes, initialRadius <= 0 derives the radius from the scene size
+    SPPMIntegrator(Camera* camera, Sampler* sampler, int iterations, int photonsPerIteration,
+                   int maxDepth = 8, Float initialRadius = 0) :
+        MonteCarloIntegrator(camera, sampler, maxDepth, -1),
+        mIterations_(iterations),
+        mPhotonsPerIteration_(photonsPerIteration),
+        mInitialRadius_(initialRadius) {
+
+    }
+
+    virtual void Render(const Scene& scene);
+
+    bool SupportsFilterSampling() const override { return false; }
+
+    bool Splats() const override { return true; }
+
+private:
+    struct VisiblePoint {
+        SurfaceIntersection si;
+        Spectrum beta;
+        bool valid = false;
+    };
+
+    struct SPPMPixel {
+        Float radius = 0;
+        // emitted and directly reflected radiance, summed over iterations
+        Spectrum Ld;
+        VisiblePoint vp;
+        // flux deposited in the current iteration, before the visible point's throughput
+        AtomicFloat phi[Spectrum::nSamples];
+        std::atomic<int> M{ 0 };
+        Float N = 0;
+        Spectrum tau;
+    };
+
+    struct VisiblePointNode {
+        int pixel;
+        int next;
+    };
+
+    // hash grid over the visible points, a point is linked into every cell its radius overlaps
+    struct VisiblePointGrid {
+        AABB3 bounds;
+        int resolution[3];
+        std::vector<std::atomic<int>> heads;
+        std::vector<VisiblePointNode> nodes;
+
+        bool ToGrid(const Point3& p, Point3i* pi) const;
+
+        int Hash(const Point3i& pi) const;
+    };
+
+    void GenerateVisiblePoints(const Scene& scene, std::vector<SPPMPixel>& pixels, int iteration) const;
+
+    void BuildGrid(std::vector<SPPMPixel>& pixels, VisiblePointGrid& grid) const;
+
+    void TracePhotons(const Scene& scene, std::vector<SPPMPixel>& pixels, const VisiblePointGrid& grid, int iteration) const;
+
+    void UpdatePixels(std::vector<SPPMPixel>& pixels) const;
+
+    int mIterations_;
+    int mPhotonsPerIteration_;
+    Float mInitialRadius_;
+};
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <RayFlow/Integrators/bdpt.h>
+
+namespace rayflow {
+
+// vertex connection and merging, "Light Transport Simulation with Vertex Connection and Merging"
+// (Georgiev et al. 2012). MIS weights come from the recursive partial sums dVCM, dVC and dVM kept
+// along each subpath, so no subpath is walked again when a connection is weighted
+class VCMIntegrator : public MonteCarloIntegrator {
+public:
+    // every sample per pixel is one iteration, initialRadius <= 0 derives the merge radius from the scene size
+    VCMIntegrator(Camera* camera, Sampler* sampler, int maxDepth = 8, Float initialRadius = 0) :
+        MonteCarloIntegrator(camera, sampler, maxDepth, -1),
+        mInitialRadius_(initialRadius) {
+
+    }
+
+    virtual void Render(const Scene& scene);
+
+    bool SupportsFilterSampling() const override { return false; }
+
+    bool Splats() const override { return true; }
+
+private:
+    // exponent of the radius reduction, the radius shrinks by iteration^((alpha - 1) / 2)
+    static constexpr Float RadiusAlpha = 0.75f;
+
+    // balance heuristic
+    static Float Mis(Float pdf) { return pdf; }
+
+    struct IterationState {
+        Float radius;
+        Float misVMWeight;
+        Float misVCWeight;
+        Float vmNormalization;
+        Float lightPathCount;
+        Float pixelCount;
+    };
+
+    struct SubpathState {
+        Spectrum throughput;
+        // number of segments from the subpath origin
+        int pathLength;
+        Float dVCM;
+        Float dVC;
+        Float dVM;
+    };
+
+    // the BSDF is evaluated again on use, the pool it was allocated from does not outlive the light pass
+    struct LightVertex {
+        SurfaceIntersection si;
+        Spectrum throughput;
+        int pathLength;
+        Float dVCM;
+        Float dVC;
+        Float dVM;
+    };
+
+    // hash grid over the light vertices of an iteration, cells are twice the merge radius wide so a
+    // range query visits at most 2x2x2 cells
+    struct LightVertexGrid {
+        AABB3 bounds;
+        Float cellSize = 0;
+        // vertices of cell c are indices[cellEnds[c - 1], cellEnds[c])
+        std::vector<int> cellEnds;
+        std::vector<int> indices;
+
+        Point3i Cell(const Point3& p) const;
+
+        int Hash(const Point3i& pi) const;
+
+        void Build(const std::vector<LightVertex>& vertices, Float radius);
+
+        template <typename F>
+        void Query(const std::vector<LightVertex>& vertices, const Point3& p, Float radius, F&& f) const {
+            if (indices.empty()) {
+                return;
+            }
+
+            Vector3 r(radius, radius, radius);
+            if (!Inside(p, AABB3(bounds.pMin - r, bounds.pMax + r))) {
+                return;
+            }
+
+            Vector3 offset = (p - bounds.pMin) / cellSize;
+            Point3i cell = Cell(p);
+            Point3i neighbor;
+            for (int i = 0; i < 3; ++i) {
+                neighbor[i] = cell[i] + ((offset[i] - cell[i] < 0.5f) ? -1 : 1);
+            }
+
+            int visited[8];
+            int nVisited = 0;
+
+            for (int j = 0; j < 8; ++j) {
+                Point3i pi((j & 1) ? neighbor.x : cell.x, (j & 2) ? neighbor.y : cell.y, (j & 4) ? neighbor.z : cell.z);
+                int h = Hash(pi);
+
+                // distinct cells may share a bucket, a bucket is searched once
+                if (std::find(visited, visited + nVisited, h) != visited + nVisited) {
+                    continue;
+                }
+                visited[nVisited++] = h;
+
+                for (int k = (h == 0 ? 0 : cellEnds[h - 1]); k < cellEnds[h]; ++k) {
+                    const LightVertex& vertex = vertices[indices[k]];
+
+                    if (DistanceSquare(vertex.si.p, p) <= radius * radius) {
+                        f(vertex);
+                    }
+                }
+            }
+        }
+    };
+
+    void TraceLightPaths(const Scene& scene, int iteration, const IterationState& it,
+                         std::vector<LightVertex>& vertices, std::vector<int>& pathEnds) const;
+
+    void TraceLightPath(const Scene& scene, Sampler& sampler, const IterationState& it,
+                        std::vector<LightVertex>& vertices) const;
+
+    void TraceCameraPaths(const Scene& scene, int iteration, const IterationState& it,
+                          const std::vector<LightVertex>& vertices, const std::vector<int>& pathEnds,
+                          const LightVertexGrid& grid) const;
+
+    Spectrum CameraPathLi(const Scene& scene, Sampler& sampler, const Point2& pFilm, const IterationState& it,
+                          const std::vector<LightVertex>& vertices, int lightPathBegin, int lightPathEnd,
+                          const LightVertexGrid& grid) const;
+
+    // emitted radiance reached by a camera subpath
+    Spectrum EmittedRadiance(const Scene& scene, const SurfaceIntersection& si, const Point3& pPrev,
+                             const SubpathState& state) const;
+
+    // connection of a camera vertex to a new light sample
+    Spectrum DirectIllumination(const Scene& scene, Sampler& sampler, const SurfaceIntersection& si,
+                                const BSDF& bsdf, const SubpathState& state, const IterationState& it) const;
+
+    // connection of a light vertex to the camera, pRaster receives the film position of the splat
+    Spectrum ConnectToCamera(const Scene& scene, Sampler& sampler, const SurfaceIntersection& si,
+                             const BSDF& bsdf, const SubpathState& state, const IterationState& it,
+                             Point2* pRaster) const;
+
+    Spectrum ConnectVertices(const Scene& scene, const LightVertex& vertex, const SurfaceIntersection& si,
+                             const BSDF& bsdf, const SubpathState& state, const IterationState& it) const;
+
+    // sum of the merges with the light vertices around si, without the kernel normalization
+    Spectrum MergeVertices(const SurfaceIntersection& si, const BSDF& bsdf, const SubpathState& state,
+                           const IterationState& it, const std::vector<LightVertex>& vertices,
+                           const LightVertexGrid& grid) const;
+
+    // samples the next direction and advances the partial MIS sums
+    bool SampleScattering(const SurfaceIntersection& si, const BSDF& bsdf, Sampler& sampler, TransportMode mode,
+                          const IterationState& it, SubpathState& state, Ray* ray) const;
+
+    Float mInitialRadius_;
+};
+
+}
@@ -61,6 +61,33 @@ namespace rayflow
             mBXDFs_[nComponents++] = bxdf;
         }
 
+        // true when every component is a delta distribution
+        RAYFLOW_CPU_GPU bool IsSpecular() const
+        {
+            for (int i = 0; i < nComponents; ++i)
+            {
+                if (!HasSpecularComponent(mBXDFs_[i]->type))
+                {
+                    return false;
+                }
+            }
+            return nComponents > 0;
+        }
+
+        // true when every component is purely diffuse, so the outgoing radiance does not depend on the direction
+        RAYFLOW_CPU_GPU bool IsDiffuse() const
+        {
+            for (int i = 0; i < nComponents; ++i)
+            {
+                int type = (int)mBXDFs_[i]->type;
+                if (!(type & (int)BXDFType::DIFFUSE) || (type & ((int)BXDFType::GLOSSY | (int)BXDFType::SPECULAR)))
+                {
+                    return false;
+                }
+            }
+            return nComponents > 0;
+        }
+
     private:
         RAYFLOW_CPU_GPU Vector3 ToLocal(const Vector3 &v) const
         {
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <RayFlow/Render/film.h>
+
+namespace rayflow {
+
+// edge-avoiding a-trous wavelet filter guided by the film's feature buffers, "Edge-Avoiding A-Trous
+// Wavelet Transform for fast Global Illumination Filtering" (Dammertz et al. 2010) with the variance
+// guided luminance weight of SVGF (Schied et al. 2017). The albedo is divided out before filtering
+// and multiplied back afterwards, so texture detail is not blurred
+class Denoiser {
+public:
+    // the footprint of the 5x5 kernel doubles every iteration, sigmas scale the edge stopping functions
+    Denoiser(int iterations = 5, Float sigmaLuminance = 4, Float sigmaNormal = 128, Float sigmaDepth = 0.1f) :
+        mIterations_(iterations),
+        mSigmaLuminance_(sigmaLuminance),
+        mSigmaNormal_(sigmaNormal),
+        mSigmaDepth_(sigmaDepth) {
+
+    }
+
+    // color and output hold resolution.x * resolution.y pixels, features are the film's AOV pixels
+    void Denoise(const Point2i& resolution, const Spectrum* color, const AOVPixel* features, Spectrum* output) const;
+
+private:
+    // features of every pixel as separate planes
+    struct FeatureBuffers {
+        std::vector<Float> normalX;
+        std::vector<Float> normalY;
+        std::vector<Float> normalZ;
+        std::vector<Float> depth;
+    };
+
+    void FilterIteration(const Point2i& resolution, int step, const FeatureBuffers& features,
+                         const std::vector<Spectrum>& color, const std::vector<Float>& variance,
+                         std::vector<Spectrum>& filtered, std::vector<Float>& filteredVariance) const;
+
+    int mIterations_;
+    Float mSigmaLuminance_;
+    Float mSigmaNormal_;
+    Float mSigmaDepth_;
+};
+
+}
@@ -6,6 +6,10 @@
 #include <RayFlow/Std/memory_resource.h>
 #include <RayFlow/Std/vector.h>
 #include <RayFlow/Util/atomic_float.h>
+#include <RayFlow/Util/parallel.h>
+
+#include <memory>
+#include <fstream>
 
 namespace rayflow {
 
@@ -27,24 +31,60 @@ struct FilmTilePixel {
     Float weightSum;
 };
 
+// first hit features of a camera sample, a miss keeps the defaults
+struct AOVSample {
+    Spectrum albedo;
+    Normal3 normal;
+    Float depth = 0;
+    int primitiveId = -1;
+    int materialId = -1;
+};
+
+// auxiliary buffers of a pixel, features are summed over its samples and ids come from the first one
+struct AOVPixel {
+    Spectrum albedo;
+    Vector3 normal;
+    Float depth = 0;
+    int primitiveId = -1;
+    int materialId = -1;
+    int sampleCount = 0;
+    // moments of the radiance luminance for the pixel variance
+    Float luminanceSum = 0;
+    Float luminanceSquareSum = 0;
+};
+
 class FilmTile;
+class Denoiser;
 
 class Film {
 public:
+    // a streaming film keeps no pixels, merged tiles are appended to <image>.tiles and Write assembles
+    // the image from them band by band into an exr. AOVs, the denoiser and splats need the full frame
     Film(const AABB2i& bounds, const Point2i& resolution, 
          const Filter* filter, const std::string& filename,
-         Allocator alloc) :
+         Allocator alloc, bool streaming = false) :
         bounds(bounds),
         resolution(resolution),
         mFilter_(filter),
         mFilename_(filename),
+        mStreaming_(streaming),
         mAlloc_(alloc) {
         int pixelCount = resolution.x * resolution.y;
 
-        mBitMap_ = new BitMap(BitMapPixelFormat::ERGB, BitMapComponentFormat::EUInt8, resolution, 
-                (uint8_t*)alloc.allocate_object<Spectrum>(pixelCount));
+        if (!mStreaming_) {
+            mBitMap_ = new BitMap(BitMapPixelFormat::ERGB, BitMapComponentFormat::EUInt8, resolution, 
+                    (uint8_t*)alloc.allocate_object<Spectrum>(pixelCount));
         
-        mPixels_ = new Pixel[pixelCount];
+            mPixels_ = new Pixel[pixelCount];
+        }
+
+        mSplatTileCount_ = Point2i((resolution.x + splatTileWidth - 1) / splatTileWidth,
+                                   (resolution.y + splatTileWidth - 1) / splatTileWidth);
+        // the last buffer is shared by the threads beyond max_concurrency
+        mSplatBuffers_.resize(tbb::this_task_arena::max_concurrency() + 1);
+        for (SplatBuffer& buffer : mSplatBuffers_) {
+            buffer.tiles.resize(mSplatTileCount_.x * mSplatTileCount_.y);
+        }
 
         Vector2 filterRadius = mFilter_->Radius();
         int offset = 0;
@@ -59,15 +99,62 @@ public:
         }
     }
 
+    // tiles created afterwards also collect AOVSamples, Write stores them as float images next to the image
+    void EnableAOVs() {
+        if (mStreaming_) {
+            std::cout << "ERROR::A streaming film has no feature buffers\n";
+            return;
+        }
+        mAOVPixels_.resize(resolution.x * resolution.y);
+    }
+
+    bool Streaming() const {
+        return mStreaming_;
+    }
+
+    bool HasAOVs() const {
+        return !mAOVPixels_.empty();
+    }
+
+    void SetFilename(const std::string& filename) {
+        mFilename_ = filename;
+    }
+
+    // Write also stores the denoised image as <image>_denoised, needs the AOVs
+    void SetDenoiser(const Denoiser* denoiser) {
+        mDenoiser_ = denoiser;
+    }
+
+    // camera samples importance sample the filter and count for a single pixel, tiles stop overlapping.
+    // Has to be set before the tiles are created and only for integrators that support it
+    void SetFilterSampling(bool filterSampling) {
+        mFilterSampling_ = filterSampling;
+    }
+
+    bool FilterSampling() const {
+        return mFilterSampling_;
+    }
+
+    const Filter* GetFilter() const {
+        return mFilter_;
+    }
+
     FilmTile* GetFilmTile(const AABB2i &sampleBounds);
 
     void MergeFilmTile(FilmTile* tile);
 
+    // splats of worker threads go to their own buffer without atomics, Write sums the buffers. A thread
+    // allocates at most maxResidentSplatTiles tiles, splats to further tiles fall back to atomic adds. A
+    // streaming film has no pixels to fall back to, integrators that splat are rejected for it
     void AddSplat(const Point2f &p, Spectrum v);
 
     void Write(Float lightImageScale = 0.f);
 
     AABB2i GetSampledBounds() const {
+        if (mFilterSampling_) {
+            return bounds;
+        }
+
         Vector2 filterRadius = mFilter_->Radius();
         Point2 pMin = Point2(bounds.pMin) + Vector2(0.5f, 0.5f) - Vector2(filterRadius.x, filterRadius.y);
         Point2 pMax = Point2(bounds.pMax) - Vector2(0.5f, 0.5f) + Vector2(filterRadius.x, filterRadius.y);
@@ -78,12 +165,40 @@ public:
     const Point2i resolution;
     const AABB2i bounds;
 private:
+    // splats of one thread, a tile is allocated the first time a splat lands in it
+    struct SplatBuffer {
+        std::vector<std::unique_ptr<Spectrum[]>> tiles;
+        int residentTileCount = 0;
+    };
+
+    // a tile appended to the tile file, FilmTilePixels row by row, splats are added unweighted
+    struct TileRecord {
+        AABB2i bounds;
+        std::streamoff offset;
+        bool splat;
+    };
+
     std::string mFilename_;
 
-    Pixel* mPixels_;
+    Pixel* mPixels_ = nullptr;
+    bool mStreaming_;
+    std::fstream mTileFile_;
+    std::vector<TileRecord> mTileRecords_;
+    std::mutex mTileFileMutex_;
+    static constexpr int splatTileWidth = 32;
+    // 24 MB per thread, a 1080p frame fits entirely
+    static constexpr int maxResidentSplatTiles = 2048;
+    Point2i mSplatTileCount_;
+    std::vector<SplatBuffer> mSplatBuffers_;
+    std::mutex mSharedSplatMutex_;
+    std::vector<AOVPixel> mAOVPixels_;
+    const Denoiser* mDenoiser_ = nullptr;
+    bool mFilterSampling_ = false;
     const Filter* mFilter_;
-    BitMap* mBitMap_;
-    std::mutex mutex;
+    BitMap* mBitMap_ = nullptr;
+    // tiles overlap by the filter radius, merges lock the rows they add to
+    static constexpr int mergeStripeCount = 64;
+    std::mutex mMergeMutexes_[mergeStripeCount];
     static constexpr int filterTableWidth = 16;
     Float filterTable[filterTableWidth * filterTableWidth];
     
@@ -97,25 +212,50 @@ private:
         return mPixels_[p.y * resolution.x + p.x];
     }
 
+    // the image, its AOVs and the denoised image are written as OpenEXR instead of 8 bit and pfm
+    bool IsEXR() const;
+
+    void WriteAOVs() const;
+
+    // adds the splat buffers of all threads to the pixels in parallel and clears them
+    void ResolveSplats();
+
+    void AppendTileRecord(const AABB2i& recordBounds, const FilmTilePixel* pixels, bool splat);
+
+    std::string TileFilename() const;
+
+    // sums the tile records band by band into an exr and removes the tile file
+    void WriteStreamed(Float lightImageScale);
+
     Allocator mAlloc_;
 };
 
 class FilmTile {    
 public:
 
+    // singlePixel marks a box filter that never reaches beyond the pixel a sample lies in
     FilmTile(const AABB2i& bounds, const Vector2& filterRadius, 
-             const Float* filterTable, const int filterTableWidth) :
+             const Float* filterTable, const int filterTableWidth, bool singlePixel = false) :
              bounds(bounds),
              filterRadius(filterRadius),
              invFilterRadius(Vector2(1 / filterRadius.x, 1 / filterRadius.y)),
              filterTable(filterTable),
-             filterTableWidth(filterTableWidth) {
+             filterTableWidth(filterTableWidth),
+             singlePixel(singlePixel) {
         pixels.resize(bounds.Area());
     }
 
 
     void AddSample(const Point2& pFilm, const Spectrum& L, const Spectrum& importance = Spectrum(1.0f));
 
+    // a sample that importance sampled the filter, it only counts for pixel p
+    void AddPixelSample(const Point2i& p, const Spectrum& L, Float weight);
+
+    // unfiltered, the sample only reaches the pixel it lies in
+    void AddAOVSample(const Point2& pFilm, const AOVSample& aov);
+
+    bool HasAOVs() const { return !aovPixels.empty(); }
+
     FilmTilePixel& GetPixel(const Point2i&p ) {
         int width = bounds.pMax.x - bounds.pMin.x;
         int offset = (p.x - bounds.pMin.x) + (p.y - bounds.pMin.y) * width;
@@ -132,11 +272,22 @@ public:
 
 private:
     rstd::vector<FilmTilePixel> pixels;
+    rstd::vector<AOVPixel> aovPixels;
     const AABB2i bounds;
     const Vector2 filterRadius;
     const Vector2 invFilterRadius;
     const Float* filterTable;
     const int filterTableWidth;
+    const bool singlePixel;
+
+    // filter table columns and rows of footprints up to this width live on the stack
+    static constexpr int maxFootprintWidth = 16;
+
+    template <bool SinglePixel>
+    void Splat(const Point2& pFilm, const Spectrum& L);
+
+    // radiance moments of the pixel for the denoiser
+    void AddLuminance(const Point2i& p, const Spectrum& L);
 
     friend class Film;
 };
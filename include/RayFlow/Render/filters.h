@@ -2,6 +2,9 @@
 
 #include <RayFlow/Util/vecmath.h>
 
+#include <algorithm>
+#include <vector>
+
 namespace rayflow {
 
 enum class FilterType {
@@ -9,6 +12,56 @@ enum class FilterType {
     Gaussian
 };
 
+// offset from the pixel center and the sample's weight f / (pdf * integral), 1 for an exactly sampled filter
+struct FilterSample {
+    Point2 p;
+    Float weight;
+};
+
+// piecewise constant density over [min, max) proportional to the absolute tabulated values
+class PiecewiseConstant1D {
+public:
+    PiecewiseConstant1D() = default;
+
+    PiecewiseConstant1D(const std::vector<Float>& f, Float min, Float max) :
+        func(f.size()),
+        cdf(f.size() + 1),
+        min(min),
+        max(max) {
+        int n = int(f.size());
+        cdf[0] = 0;
+        for (int i = 0; i < n; ++i) {
+            func[i] = std::abs(f[i]);
+            cdf[i + 1] = cdf[i] + func[i] * (max - min) / n;
+        }
+
+        integral = cdf[n];
+        for (int i = 1; i <= n; ++i) {
+            cdf[i] = integral > 0 ? cdf[i] / integral : Float(i) / n;
+        }
+    }
+
+    Float Sample(Float u, Float* pdf) const {
+        int n = int(func.size());
+        int offset = int(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin()) - 1;
+        offset = Clamp(offset, 0, n - 1);
+
+        Float du = u - cdf[offset];
+        if (cdf[offset + 1] - cdf[offset] > 0) {
+            du /= cdf[offset + 1] - cdf[offset];
+        }
+
+        *pdf = integral > 0 ? func[offset] / integral : 1 / (max - min);
+        return Lerp(min, max, (offset + du) / n);
+    }
+
+private:
+    std::vector<Float> func;
+    std::vector<Float> cdf;
+    Float min = 0;
+    Float max = 1;
+    Float integral = 0;
+};
 
 class Filter {
 public:
@@ -22,6 +75,9 @@ public:
 
     RAYFLOW_CPU_GPU virtual Float Integral() const = 0;
 
+    // importance samples the filter, a camera sample through pixel center + p then counts for the pixel alone
+    virtual FilterSample Sample(const Point2& u) const = 0;
+
 protected:
     Vector2 radius;
 };
@@ -38,6 +94,10 @@ public:
     RAYFLOW_CPU_GPU Float Integral() const final {
         return 2 * radius.x * 2 * radius.y;
     }
+
+    FilterSample Sample(const Point2& u) const final {
+        return FilterSample{ Point2(Lerp(-radius.x, radius.x, u[0]), Lerp(-radius.y, radius.y, u[1])), 1 };
+    }
 };
 
 class GaussianFilter : public Filter {
@@ -47,7 +107,16 @@ public:
         sigma(sigma),
         expX(Gaussian(radius.x, 0, sigma)),
         expY(Gaussian(radius.y, 0, sigma)) {
-
+        // the filter is separable, every axis is sampled from its own table
+        std::vector<Float> fx(SampleTableSize), fy(SampleTableSize);
+        for (int i = 0; i < SampleTableSize; ++i) {
+            Float t = (i + 0.5f) / SampleTableSize;
+            fx[i] = std::max<Float>(0, Gaussian(Lerp(-radius.x, radius.x, t), 0, sigma) - expX);
+            fy[i] = std::max<Float>(0, Gaussian(Lerp(-radius.y, radius.y, t), 0, sigma) - expY);
+        }
+        distributionX = PiecewiseConstant1D(fx, -radius.x, radius.x);
+        distributionY = PiecewiseConstant1D(fy, -radius.y, radius.y);
+        integral = Integral();
     }
 
     RAYFLOW_CPU_GPU Float Evaluate(const Point2& p) const final {
@@ -60,10 +129,23 @@ public:
                 (GaussianIntegral(-radius.y, radius.y, 0, sigma) - 2 * radius.y * expY));
     }
 
+    FilterSample Sample(const Point2& u) const final {
+        Float pdfX, pdfY;
+        Point2 p(distributionX.Sample(u[0], &pdfX), distributionY.Sample(u[1], &pdfY));
+        Float pdf = pdfX * pdfY;
+
+        return FilterSample{ p, pdf > 0 ? Evaluate(p) / (pdf * integral) : 0 };
+    }
+
 private:
+    static constexpr int SampleTableSize = 64;
+
     Float sigma;
     Float expX;
     Float expY;
+    Float integral;
+    PiecewiseConstant1D distributionX;
+    PiecewiseConstant1D distributionY;
 };
 
 }
\ No newline at end of file
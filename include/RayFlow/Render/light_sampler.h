@@ -3,19 +3,64 @@
 #include <RayFlow/Std/vector.h>
 #include <RayFlow/Std/optional.h>
 #include <RayFlow/Core/light.h>
+#include <RayFlow/Util/rng.h>
 
 namespace rayflow {
 
+enum class LightSamplerType {
+    Uniform,
+    Power,
+    Alias
+};
+
 struct SampledLight {
     Light* light;
     Float pdf;
 };
 
+// Vose's alias method: O(1) sampling of a discrete distribution
+class AliasTable {
+public:
+    AliasTable() = default;
+
+    explicit AliasTable(const rstd::vector<Float>& weights);
+
+    RAYFLOW_CPU_GPU int Sample(Float u) const {
+        int n = mBins_.size();
+        Float up = u * n;
+        int offset = std::min<int>(up, n - 1);
+        Float q = std::min<Float>(up - offset, OneMinusEpsilon);
+
+        return q < mBins_[offset].q ? offset : mBins_[offset].alias;
+    }
+
+    RAYFLOW_CPU_GPU Float PMF(int idx) const {
+        return mBins_[idx].p;
+    }
+
+    RAYFLOW_CPU_GPU size_t size() const {
+        return mBins_.size();
+    }
+
+private:
+    struct Bin {
+        // probability of keeping this bin
+        Float q = 0;
+        // probability of sampling this bin
+        Float p = 0;
+        int alias = -1;
+    };
+
+    rstd::vector<Bin> mBins_;
+};
+
 class LightSampler {
 public:
     LightSampler(const std::vector<Light*>& lights) :
         mLights_(lights) {
-
+        for (size_t i = 0; i < mLights_.size(); ++i) {
+            mLights_[i]->index = int(i);
+        }
     }
 
     RAYFLOW_CPU_GPU virtual ~LightSampler() = default;
@@ -29,6 +74,15 @@ public:
     }
 
 protected:
+    // O(1) light -> index lookup, -1 if the light does not belong to this sampler
+    RAYFLOW_CPU_GPU int IndexOf(const Light* light) const {
+        if (light == nullptr || light->index < 0 || size_t(light->index) >= mLights_.size() ||
+            mLights_[light->index] != light) {
+            return -1;
+        }
+        return light->index;
+    }
+
     std::vector<Light*> mLights_;
 };
 
@@ -39,13 +93,13 @@ public:
 
     }
 
-    RAYFLOW_CPU_GPU SampledLight Sample(const Point3& p, Float u) const override {
+    RAYFLOW_CPU_GPU SampledLight Sample(const Point3&, Float u) const override {
         int nLights = mLights_.size();
         int idx = std::min(int(u * nLights), nLights - 1);
         return SampledLight{mLights_[idx], 1.0f / mLights_.size()};
     }
 
-    RAYFLOW_CPU_GPU Float Pdf(const Point3& p, const Light* light) const override {
+    RAYFLOW_CPU_GPU Float Pdf(const Point3&, const Light*) const override {
         return 1.0f / mLights_.size();
     }
 
@@ -76,20 +130,16 @@ public:
         mPowerCdf_[n] = 1;
     }
 
-    RAYFLOW_CPU_GPU SampledLight Sample(const Point3& p, Float u) const override {
+    RAYFLOW_CPU_GPU SampledLight Sample(const Point3&, Float u) const override {
         int offset = FindInterval((int)mPowerCdf_.size(), 
                                   [&](int idx)->bool {
                                     return mPowerCdf_[idx] <= u;});
         return SampledLight{mLights_[offset], mPowerPdf_[offset]};
     }
 
-    RAYFLOW_CPU_GPU Float Pdf(const Point3& p, const Light* light) const override {
-        for (int i = 0; i < mLights_.size(); ++i) {
-            if (light == mLights_[i]) {
-                return mPowerPdf_[i];
-            }
-        }
-        return 0;
+    RAYFLOW_CPU_GPU Float Pdf(const Point3&, const Light* light) const override {
+        int idx = IndexOf(light);
+        return idx < 0 ? 0 : mPowerPdf_[idx];
     }   
     
 private:
@@ -97,4 +147,25 @@ private:
     rstd::vector<Float> mPowerCdf_;
 };
 
+// power proportional sampling with constant time Sample and Pdf
+class AliasLightSampler final : public LightSampler {
+public:
+    AliasLightSampler(const std::vector<Light*>& lights);
+
+    RAYFLOW_CPU_GPU SampledLight Sample(const Point3&, Float u) const override {
+        int idx = mAliasTable_.Sample(u);
+        return SampledLight{mLights_[idx], mAliasTable_.PMF(idx)};
+    }
+
+    RAYFLOW_CPU_GPU Float Pdf(const Point3&, const Light* light) const override {
+        int idx = IndexOf(light);
+        return idx < 0 ? 0 : mAliasTable_.PMF(idx);
+    }
+
+private:
+    AliasTable mAliasTable_;
+};
+
+LightSampler* CreateLightSampler(LightSamplerType type, const std::vector<Light*>& lights);
+
 }
\ No newline at end of file
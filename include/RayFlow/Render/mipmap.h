@@ -0,0 +1,72 @@
+#pragma once
+
+#include <RayFlow/Util/bitmap.h>
+#include <RayFlow/Core/spectrum.h>
+
+#include <vector>
+
+namespace rayflow {
+
+class TextureCache;
+
+enum class ImageTextureWrapMode {
+    REPEAT,
+    CLAMP
+};
+
+// image pyramid of a texture, every level halves the resolution of the one above down to a single texel.
+// Lookups take st in [0, 1) and footprints in st units, the finer texels are only touched by footprints
+// small enough to need them
+class MIPMap {
+public:
+    // levels are box filtered in parallel
+    MIPMap(const BitMap& image, ImageTextureWrapMode wrapMode = ImageTextureWrapMode::REPEAT);
+
+    // texels are paged in from the cache on demand
+    MIPMap(const TextureCache* cache, int textureId, ImageTextureWrapMode wrapMode = ImageTextureWrapMode::REPEAT);
+
+    static std::vector<Point2i> PyramidResolutions(const Point2i& resolution);
+
+    int Levels() const { return int(mLevels_.size()); }
+
+    Point2i LevelResolution(int level) const { return mLevels_[level].resolution; }
+
+    Spectrum Texel(int level, const Point2i& st) const;
+
+    Spectrum Nearest(const Point2& st) const;
+
+    Spectrum Bilerp(int level, const Point2& st) const;
+
+    // bilinear lookups in the two levels around a square footprint of the given width
+    Spectrum Trilinear(const Point2& st, Float width) const;
+
+    // elliptically weighted average over the footprint spanned by the derivatives, "Creating Raster
+    // Omnimax Images from Multiple Perspective Views Using the Elliptical Weighted Average Filter"
+    // (Greene and Heckbert 1986). Very eccentric footprints are widened to MaxAnisotropy
+    Spectrum EWA(const Point2& st, Vector2 dst0, Vector2 dst1) const;
+
+private:
+    // texels are stored as half RGB, the same as the tiles of the texture cache
+    struct Level {
+        Point2i resolution;
+        std::vector<Half> texels;
+
+        void Set(int index, const Spectrum& value) {
+            for (int c = 0; c < 3; ++c) {
+                texels[3 * index + c] = Half(float(value[c]));
+            }
+        }
+    };
+
+    Spectrum EWALevel(int level, Point2 st, Vector2 dst0, Vector2 dst1) const;
+
+    static constexpr Float MaxAnisotropy = 8;
+    static constexpr int WeightTableSize = 128;
+
+    std::vector<Level> mLevels_;
+    ImageTextureWrapMode mWrapMode_;
+    const TextureCache* mCache_ = nullptr;
+    int mTextureId_ = -1;
+};
+
+}
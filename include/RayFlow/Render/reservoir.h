@@ -0,0 +1,61 @@
+#pragma once
+
+#include <RayFlow/Render/scene.h>
+#include <RayFlow/Render/bxdfs.h>
+#include <RayFlow/Core/sampler.h>
+
+namespace rayflow {
+
+// Resampled importance sampling of direct lighting from "Spatiotemporal reservoir resampling for
+// real-time ray tracing with dynamic direct lighting" (Bitterli et al. 2020).
+
+struct LightCandidate {
+    const Light* light = nullptr;
+    LightLiSample ls;
+    // target function, luminance of the unshadowed contribution times misWeight
+    Float pHat = 0;
+    // MIS weight against BSDF sampling, 1 unless the reservoir was resampled for MIS
+    Float misWeight = 1;
+};
+
+// keeps one streamed candidate with probability proportional to its resampling weight
+struct LightReservoir {
+    RAYFLOW_CPU_GPU bool Update(const LightCandidate& candidate, Float weight, Float u) {
+        weightSum += weight;
+        ++M;
+
+        if (weight > 0 && u * weightSum < weight) {
+            sample = candidate;
+            return true;
+        }
+        return false;
+    }
+
+    // contribution weight of the kept candidate, it replaces 1 / pdf in the estimator
+    RAYFLOW_CPU_GPU Float W() const {
+        return (M > 0 && sample.pHat > 0) ? weightSum / (M * sample.pHat) : 0;
+    }
+
+    LightCandidate sample;
+    Float weightSum = 0;
+    int M = 0;
+};
+
+Float LightTargetPdf(const SurfaceIntersection& si, const BSDF& bsdf, const LightLiSample& ls);
+
+// streams candidateCount light samples from the scene light sampler through a reservoir,
+// no shadow ray is traced. With bsdfMIS the targets are power heuristic weighted against the BSDF pdf,
+// so the caller can add emitters hit by BSDF sampling with the complementary weight
+LightReservoir ResampleLights(const Scene& scene, const SurfaceIntersection& si, const BSDF& bsdf,
+                              Sampler& sampler, int candidateCount, bool bsdfMIS = false);
+
+// merges the reservoir of a neighboring shading point pNeighbor into r, the neighbor's sample is
+// reevaluated at si. Visibility is not tested, so the combination is biased but consistent
+bool MergeReservoir(LightReservoir& r, const SurfaceIntersection& si, const BSDF& bsdf,
+                    const LightReservoir& neighbor, const Point3& pNeighbor, Float u);
+
+// contribution of the kept sample, traces its shadow ray
+Spectrum ShadeReservoir(const Scene& scene, const SurfaceIntersection& si, const BSDF& bsdf,
+                        const LightReservoir& r);
+
+}
@@ -2,6 +2,9 @@
 
 #include <RayFlow/Core/sampler.h>
 #include <RayFlow/Util/rng.h>
+#include <RayFlow/Util/lowdiscrepancy.h>
+
+#include <memory>
 
 namespace rayflow {
 
@@ -41,6 +44,114 @@ private:
     std::vector<std::vector<Point2>> mSamples2D;
 };
 
+// independent uniform samples, for sample streams without a pixel such as photon paths
+class RandomSampler : public Sampler {
+public:
+    RandomSampler(size_t sampleCount, uint64_t seed = 0) :
+        Sampler(sampleCount),
+        rng(seed) {
+
+    }
+
+    RAYFLOW_CPU_GPU Sampler* Clone(uint64_t seed) final;
+
+    RAYFLOW_CPU_GPU Float Get1D() final;
+
+    RAYFLOW_CPU_GPU Point2 Get2D() final;
+
+public:
+    Rng rng;
+};
+
+// Owen scrambled Sobol points evaluated on the fly from (pixel, sample index, dimension), no tables.
+// Consecutive dimensions are padded pairs of the 2D Sobol (0, 2)-sequence, every pair with its own
+// scrambling and sample order, so stratification holds at any depth
+class SobolSampler : public Sampler {
+public:
+    SobolSampler(size_t sampleCount, uint64_t seed = 0) :
+        Sampler(sampleCount),
+        mSeed_(seed) {
+
+    }
+
+    RAYFLOW_CPU_GPU void StartPixel(const Point2i& pos) final;
+
+    RAYFLOW_CPU_GPU void Advance() final;
+
+    RAYFLOW_CPU_GPU Sampler* Clone(uint64_t seed) final;
+
+    RAYFLOW_CPU_GPU Float Get1D() final;
+
+    RAYFLOW_CPU_GPU Point2 Get2D() final;
+
+private:
+    uint64_t Hash() const;
+
+    uint64_t mSeed_;
+    int mDimension_ = 0;
+};
+
+// progressive multi-jittered (0, 2) point sets, "Progressive Multi-Jittered Sample Sequences"
+// (Christensen et al. 2018). The sets are generated once as Owen scrambled 2D Sobol points, which have
+// the same distribution as pmj02 (Helmer et al. 2021). Every pixel and dimension pair reads one set with
+// its own random digit scrambling, that keeps every prefix of a pixel's samples stratified, so the
+// sample count needs to be neither a square nor a power of two
+class PMJ02Sampler : public Sampler {
+public:
+    PMJ02Sampler(size_t sampleCount, uint64_t seed = 0, int setCount = 64);
+
+    RAYFLOW_CPU_GPU void StartPixel(const Point2i& pos) final;
+
+    RAYFLOW_CPU_GPU void Advance() final;
+
+    RAYFLOW_CPU_GPU Sampler* Clone(uint64_t seed) final;
+
+    RAYFLOW_CPU_GPU Float Get1D() final;
+
+    RAYFLOW_CPU_GPU Point2 Get2D() final;
+
+private:
+    uint64_t Hash() const;
+
+    uint64_t mSeed_;
+    int mDimension_ = 0;
+    int mSetCount_;
+    // mSetCount_ sets of mSetSize_ points, shared by the clones
+    int mSetSize_;
+    std::shared_ptr<std::vector<uint32_t>> mPoints_;
+};
+
+// Sobol samples indexed in Morton order over the whole film, "Screen-Space Blue-Noise Sampling via
+// Sobol' Sequence Ordering" (Ahmed and Wonka 2020) as in pbrt-v4. Neighboring pixels take disjoint parts
+// of one sequence, with the base 4 digits of the index permuted per level, so the error of nearby pixels
+// is negatively correlated and looks like blue noise. Clones keep the scrambling seed of the prototype, so
+// the pattern runs across tile borders, passes over the same pixels mix their index into it
+class ZSobolSampler : public Sampler {
+public:
+    ZSobolSampler(size_t sampleCount, const Point2i& resolution, uint64_t seed = 0);
+
+    RAYFLOW_CPU_GPU void StartPixel(const Point2i& pos) final;
+
+    RAYFLOW_CPU_GPU void Advance() final;
+
+    RAYFLOW_CPU_GPU Sampler* Clone(uint64_t seed) final;
+
+    Sampler* ClonePass(uint64_t seed, int passIndex) final;
+
+    RAYFLOW_CPU_GPU Float Get1D() final;
+
+    RAYFLOW_CPU_GPU Point2 Get2D() final;
+
+private:
+    uint64_t SampleIndex() const;
+
+    uint64_t mSeed_;
+    int mDimension_ = 0;
+    int mLog2SampleCount_;
+    int mBase4Digits_;
+    uint64_t mMortonIndex_ = 0;
+};
+
 RAYFLOW_CPU_GPU void Stratified1D(Float* data, Rng& rng, int nSamples, bool jitter);
 
 RAYFLOW_CPU_GPU void Stratified2D(Point2* data, Rng& rng, int xSamples, int ySamples, bool jitter);
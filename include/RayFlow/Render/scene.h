@@ -6,28 +6,54 @@
 #include <RayFlow/Core/material.h>
 #include <RayFlow/Core/Shape.h>
 
+#include <unordered_map>
+
 
 namespace rayflow {
 
+// segment that has to be free of geometry for a connection to count, Scene::Occluded fills in occluded
+struct ShadowRay {
+    Ray ray;
+    Float tMax;
+    bool occluded = false;
+};
+
 class Scene {
 public:
-    Scene(const std::vector<Primitive>& primitives, const std::vector<Light*> lights) :
+    Scene(const std::vector<Primitive>& primitives, const std::vector<Light*> lights,
+          LightSamplerType lightSamplerType = LightSamplerType::Uniform) :
         mBVH_(primitives, 4),
-        mLightSampler_(new UniformLightSampler(lights)) {
-
+        mLightSampler_(CreateLightSampler(lightSamplerType, lights)) {
+        for (const Primitive& primitive : primitives) {
+            mMaterialIds_.emplace(primitive.GetMaterial(), int(mMaterialIds_.size()));
+        }
     }
 
     rstd::optional<ShapeIntersection> Intersect(const Ray& ray, Float tMax = INFINITY) const;
 
+    bool IntersectP(const Ray& ray, Float tMax = INFINITY) const;
+
+    // resolves a batch of shadow rays in one call, sorted by direction octant and traversed in packets
+    void Occluded(ShadowRay* rays, int count) const;
+
     SampledLight SampleLight(const Point3& p, Float u) const;
 
     const std::vector<Light*>& GetLights() const;
 
     const LightSampler* GetLightSampler() const;
 
+    AABB3 Bounds() const;
+
+    // ids of the primitive and of the material of an intersection, -1 without a primitive
+    int PrimitiveId(const SurfaceIntersection& si) const;
+
+    int MaterialId(const SurfaceIntersection& si) const;
+
 private:
     BVH mBVH_;
     LightSampler* mLightSampler_;
+    // materials numbered in the order of their first primitive
+    std::unordered_map<const Material*, int> mMaterialIds_;
 };
 
 struct VisibilityTester {
@@ -48,7 +74,7 @@ struct VisibilityTester {
 
         Ray ray = p0.SpawnRayTo(p1.p);
         
-        return !scene.Intersect(ray, ::sqrt(dist2) - ShadowEpsilon);
+        return !scene.IntersectP(ray, ::sqrt(dist2) - ShadowEpsilon);
     }
 
     SurfaceIntersection p0;
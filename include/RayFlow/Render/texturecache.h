@@ -0,0 +1,102 @@
+#pragma once
+
+#include <RayFlow/Util/vecmath.h>
+#include <RayFlow/Util/half.h>
+#include <RayFlow/Core/spectrum.h>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rayflow {
+
+// pages MIP-mapped textures in as square tiles under a memory budget. An image is converted on its first
+// lookup into a tiled file holding every level, after that only the tiles that are hit are read. Hits are
+// lock free, misses lock the texture they read from, eviction follows the clock approximation of LRU and
+// evicted tiles are freed once no thread is reading them
+class TextureCache {
+public:
+    static constexpr int TileSize = 64;
+
+    // tiled files go next to the images when directory is empty
+    TextureCache(size_t memoryBudget, const std::string& directory = "");
+
+    ~TextureCache();
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // only reads the image header, returns -1 if the image can not be read. Not thread safe
+    int AddTexture(const std::string& filename);
+
+    const std::vector<Point2i>& LevelResolutions(int textureId) const {
+        return mTextures_[textureId]->levelResolutions;
+    }
+
+    // st has to lie within the level
+    Spectrum Texel(int textureId, int level, const Point2i& st) const;
+
+    void PrintStatistics() const;
+
+private:
+    struct Tile {
+        std::atomic<Tile*>* slot;
+        std::atomic<bool> referenced{ true };
+        Half texels[TileSize * TileSize * 3];
+    };
+
+    struct Texture {
+        std::string filename;
+        std::string tiledFilename;
+        std::vector<Point2i> levelResolutions;
+        std::vector<Point2i> levelTileCounts;
+        // index of the first tile of every level in tiles and in the file
+        std::vector<int> levelTileOffsets;
+        std::unique_ptr<std::atomic<Tile*>[]> tiles;
+        std::mutex mutex;
+        std::ifstream file;
+        std::streamoff dataOffset = 0;
+        bool opened = false;
+    };
+
+    // hazard pointer and statistics of a thread, only written by that thread
+    struct alignas(64) ThreadRecord {
+        std::atomic<Tile*> hazard{ nullptr };
+        std::atomic<uint64_t> lookups{ 0 };
+        std::atomic<uint64_t> misses{ 0 };
+    };
+
+    ThreadRecord& LocalRecord() const;
+
+    void LoadTile(Texture& texture, int tileIndex, ThreadRecord& record) const;
+
+    void OpenTexture(Texture& texture) const;
+
+    bool ReadHeader(Texture& texture) const;
+
+    bool ConvertTexture(const Texture& texture) const;
+
+    // under mClockMutex_
+    bool EvictTile() const;
+    void ReclaimTiles() const;
+
+    size_t mMemoryBudget_;
+    std::string mDirectory_;
+    // tells the thread records of this cache from those of an earlier one at the same address
+    const uint64_t mGeneration_;
+    std::vector<std::unique_ptr<Texture>> mTextures_;
+
+    mutable std::mutex mClockMutex_;
+    mutable std::vector<Tile*> mResidentTiles_;
+    mutable std::vector<Tile*> mRetiredTiles_;
+    mutable size_t mClockHand_ = 0;
+    mutable size_t mResidentBytes_ = 0;
+    mutable size_t mPeakBytes_ = 0;
+    mutable uint64_t mEvictions_ = 0;
+    mutable std::vector<std::unique_ptr<ThreadRecord>> mThreadRecords_;
+};
+
+}
@@ -14,6 +14,12 @@ public:
         return Point2(su * isect.uv[0] + du, sv * isect.uv[1] + dv);
     }
 
+    RAYFLOW_CPU_GPU Point2 Map(const SurfaceIntersection& isect, Vector2* dstdx, Vector2* dstdy) const final {
+        *dstdx = Vector2(su * isect.dudx, sv * isect.dvdx);
+        *dstdy = Vector2(su * isect.dudy, sv * isect.dvdy);
+        return Map(static_cast<const Intersection&>(isect));
+    }
+
 private:
     const Float su = 1;
     const Float sv = 1;
@@ -32,6 +38,12 @@ public:
         return { phiTheta.x * Inv2Pi, phiTheta.y * InvPi };
     }
 
+    // no derivatives, lookups fall back to the finest level
+    RAYFLOW_CPU_GPU Point2 Map(const SurfaceIntersection& isect, Vector2* dstdx, Vector2* dstdy) const final {
+        *dstdx = *dstdy = Vector2(0, 0);
+        return Map(static_cast<const Intersection&>(isect));
+    }
+
 private:
     const Transform* mWorldToTexture_;
 };
@@ -2,6 +2,7 @@
 #include <RayFlow/Core/texture.h>
 #include <RayFlow/Core/spectrum.h>
 #include <RayFlow/Render/texturemappings.h>
+#include <RayFlow/Render/mipmap.h>
 #include <RayFlow/Util/bitmap.h>
 #include <RayFlow/Util/half.h>
 
@@ -78,78 +79,59 @@ private:
     const T v00, v01, v10, v11;
 };
 
-enum class ImageTextureWrapMode {
-    REPEAT,
-    CLAMP
-};
-
 enum class ImageTextureFilterType {
     NEAREST,
-    BILINEAR
+    BILINEAR,
+    TRILINEAR,
+    EWA
 };
 
+template <typename T>
+inline T FromTexel(const Spectrum& texel);
+
+template <>
+inline Spectrum FromTexel(const Spectrum& texel) {
+    return texel;
+}
+
+template <>
+inline Float FromTexel(const Spectrum& texel) {
+    return texel[0];
+}
+
 template <typename T>
 class ImageTexture : public Texture<T> {
 public:
-    ImageTexture(const TextureMapping* mapping, const BitMap* image,
-                 ImageTextureWrapMode wrapmode = ImageTextureWrapMode::REPEAT, 
-                 ImageTextureFilterType filterType = ImageTextureFilterType::BILINEAR) :
+    ImageTexture(const TextureMapping* mapping, const MIPMap* mipmap,
+                 ImageTextureFilterType filterType = ImageTextureFilterType::EWA) :
         mMapping_(mapping), 
-        mImage_(image), 
-        mResolution_(image->GetResolution()),
-        mWrapMode_(wrapmode),
+        mMIPMap_(mipmap), 
         mFilterType_(filterType) {
 
     }
 
     RAYFLOW_CPU_GPU T Evaluate(const SurfaceIntersection& isect) const final {
-        Point2 pixelPos = mMapping_->Map(isect);
-        return GetTexelValue(pixelPos);
-    }
-
-private:
-    Point2i GetWrapTexCoord(const Point2i& st) const {
-        Point2i result(st);
-        
-        if (mWrapMode_ == ImageTextureWrapMode::CLAMP) {
-            result.x = Clamp(result.x, 0, mResolution_.x - 1);
-            result.y = Clamp(result.y, 0, mResolution_.y - 1);
-        }
-        else if (mWrapMode_ == ImageTextureWrapMode::REPEAT) {
-            result.x = Mod(result.x, mResolution_.x);
-            result.y = Mod(result.y, mResolution_.y);
-        }
-        
-        return result;
-    }
-
-    T GetTexelValue(const Point2& st) const {
-        if (mFilterType_ == ImageTextureFilterType::BILINEAR) {
-            Float stx = ::floor(st.x * mResolution_.x);
-            Float sty = ::floor(st.y * mResolution_.y);
-
-            int x = ::floor(stx);
-            int y = ::floor(sty);
-
-            Float dx = stx - x;
-            Float dy = sty - y;
-
-            return (1 - dx) * (1 - dy) * mImage_->GetPixel<T>(GetWrapTexCoord(Point2i(x, y))) +
-                   dx * (1 - dy)       * mImage_->GetPixel<T>(GetWrapTexCoord(Point2i(x + 1, y))) + 
-                   (1 - dx) * dy       * mImage_->GetPixel<T>(GetWrapTexCoord(Point2i(x, y + 1))) + 
-                   dx * dy             * mImage_->GetPixel<T>(GetWrapTexCoord(Point2i(x + 1, y + 1)));
-        }
-        else {
-            Point2i sst(::floor(st.x * mResolution_.x), ::floor(st.y * mResolution_.y));
-            return mImage_->GetPixel<T>(GetWrapTexCoord(sst));
+        Vector2 dstdx, dstdy;
+        Point2 st = mMapping_->Map(isect, &dstdx, &dstdy);
+
+        switch (mFilterType_) {
+            case ImageTextureFilterType::NEAREST:
+                return FromTexel<T>(mMIPMap_->Nearest(st));
+            case ImageTextureFilterType::BILINEAR:
+                return FromTexel<T>(mMIPMap_->Bilerp(0, st));
+            case ImageTextureFilterType::TRILINEAR: {
+                Float width = 2 * std::max({ std::abs(dstdx.x), std::abs(dstdx.y),
+                                             std::abs(dstdy.x), std::abs(dstdy.y) });
+                return FromTexel<T>(mMIPMap_->Trilinear(st, width));
+            }
+            default:
+                return FromTexel<T>(mMIPMap_->EWA(st, dstdx, dstdy));
         }
     }
 
 private:
     const TextureMapping* mMapping_;
-    const BitMap* mImage_;
-    Point2i mResolution_;
-    ImageTextureWrapMode mWrapMode_;
+    const MIPMap* mMIPMap_;
     ImageTextureFilterType mFilterType_;
 };
 
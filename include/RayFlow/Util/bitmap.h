@@ -4,6 +4,8 @@
 #include <RayFlow/Util/half.h>
 #include <RayFlow/Core/spectrum.h>
 
+#include <memory>
+
 namespace rayflow {
 
 enum class BitMapPixelFormat {
@@ -48,6 +50,7 @@ public:
     }
     
     
+    // owns the decoded pixels, freed with the bitmap
     BitMap(const std::string& filename, bool gamma = true);
 
     RAYFLOW_CPU_GPU int GetPixelCount() const { 
@@ -147,18 +150,26 @@ private:
         return std::pow((value + 0.055f) * 1.f / 1.055f, (Float)2.4f);
     }
 
+    // 8 bit code of GammaCorrect(value) * 255, a binary search over the decoded codes instead of a pow
+    uint8_t QuantizeGamma(float value) const;
+
 private:
     void Read(const std::string& filename);
 
     void WritePNG(const std::string& filename) const;
 
+    // half channels, 8 bit data is linearized first
     void WriteOpenEXR(const std::string& filename) const;
 
+    // portable float map, 32 bit float data only
+    void WritePFM(const std::string& filename) const;
+
     BitMapPixelFormat mPixelFormat_;
     BitMapComponentFormat mComponentFormat_;
     BitMapFileFormat mFileFormat_;
     Point2i mResolution_;
     uint8_t *mData_;
+    std::unique_ptr<Half[]> mOwnedData_;
     bool mGamma_;
     int mChannelCount_;
 };
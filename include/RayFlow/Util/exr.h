@@ -0,0 +1,49 @@
+#pragma once
+
+#include <RayFlow/Util/vecmath.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace rayflow {
+
+enum class EXRPixelType {
+    EHalf = 1,
+    EFloat = 2
+};
+
+// uncompressed scanline OpenEXR writer without a dependency on the OpenEXR library. Scanlines are
+// streamed from top to bottom in blocks of any height, the offset table is filled in when the file is
+// closed, so only the block being written has to be in memory
+class EXRWriter {
+public:
+    // channels are in the order of the interleaved input, the file stores them sorted by name
+    EXRWriter(const std::string& filename, const Point2i& resolution,
+              const std::vector<std::string>& channels, EXRPixelType pixelType);
+
+    ~EXRWriter();
+
+    EXRWriter(const EXRWriter&) = delete;
+    EXRWriter& operator=(const EXRWriter&) = delete;
+
+    bool IsOpen() const { return mFile_ != nullptr; }
+
+    // writes the next rowCount scanlines, data holds rowCount * width pixels of interleaved channels
+    void WriteScanlines(int rowCount, const float* data);
+
+private:
+    void Close();
+
+    FILE* mFile_ = nullptr;
+    Point2i mResolution_;
+    EXRPixelType mPixelType_;
+    // input channel of every stored channel
+    std::vector<int> mChannelOrder_;
+    int mNextRow_ = 0;
+    int64_t mOffsetTablePosition_ = 0;
+    std::vector<uint64_t> mOffsets_;
+    std::vector<uint8_t> mScanline_;
+};
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <RayFlow/Util/math.h>
+#include <RayFlow/Util/rng.h>
+
+namespace rayflow {
+
+// generator matrices of the first two Sobol dimensions, together a (0, 2)-sequence in base 2.
+// The first is the van der Corput sequence, the second the Pascal matrix mod 2
+struct SobolMatrices2D {
+    uint32_t columns[2][32];
+
+    SobolMatrices2D() {
+        for (int i = 0; i < 32; ++i) {
+            columns[0][i] = 1u << (31 - i);
+            columns[1][i] = i == 0 ? (1u << 31) : (columns[1][i - 1] ^ (columns[1][i - 1] >> 1));
+        }
+    }
+};
+
+inline uint32_t SobolBits(uint64_t index, int dimension) {
+    static const SobolMatrices2D matrices;
+    uint32_t v = 0;
+
+    for (int i = 0; index != 0 && i < 32; index >>= 1, ++i) {
+        if (index & 1) {
+            v ^= matrices.columns[dimension][i];
+        }
+    }
+
+    return v;
+}
+
+// nested uniform scrambling, every bit is flipped depending on a hash of the bits above it,
+// https://github.com/mmp/pbrt-v4/blob/master/src/pbrt/util/lowdiscrepancy.h
+inline uint32_t OwenScramble(uint32_t v, uint32_t seed) {
+    if (seed & 1) {
+        v ^= 1u << 31;
+    }
+
+    for (int b = 1; b < 32; ++b) {
+        uint32_t mask = (~0u) << (32 - b);
+        if ((uint32_t)MixBits((v & mask) ^ seed) & (1u << b)) {
+            v ^= 1u << (31 - b);
+        }
+    }
+
+    return v;
+}
+
+// element i of a pseudo random permutation of [0, l) selected by p, "Correlated Multi-Jittered Sampling" (Kensler 2013)
+inline uint32_t PermutationElement(uint32_t i, uint32_t l, uint32_t p) {
+    uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+
+    do {
+        i ^= p;
+        i *= 0xe170893d;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;
+        i *= 0x0929eb3f;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | p >> 27;
+        i *= 0x6935fa69;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+
+    return (i + p) % l;
+}
+
+inline Float OwenScrambledSobol(uint64_t index, int dimension, uint32_t seed) {
+    uint32_t v = OwenScramble(SobolBits(index, dimension), seed);
+    return std::min<Float>(v * 0x1p-32f, OneMinusEpsilon);
+}
+
+}
@@ -182,6 +182,30 @@ RAYFLOW_CPU_GPU inline int32_t RoundUpPow2(int32_t v) {
     return v+1;
 }
 
+RAYFLOW_CPU_GPU inline int Log2Int(uint64_t v) {
+    int log2 = -1;
+    while (v) {
+        v >>= 1;
+        ++log2;
+    }
+    return log2;
+}
+
+// spreads the lower 32 bits of v to the even bits of the result
+RAYFLOW_CPU_GPU inline uint64_t LeftShift2(uint64_t v) {
+    v &= 0xffffffff;
+    v = (v ^ (v << 16)) & 0x0000ffff0000ffffULL;
+    v = (v ^ (v << 8)) & 0x00ff00ff00ff00ffULL;
+    v = (v ^ (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    v = (v ^ (v << 2)) & 0x3333333333333333ULL;
+    v = (v ^ (v << 1)) & 0x5555555555555555ULL;
+    return v;
+}
+
+RAYFLOW_CPU_GPU inline uint64_t EncodeMorton2(uint32_t x, uint32_t y) {
+    return (LeftShift2(y) << 1) | LeftShift2(x);
+}
+
 
 RAYFLOW_CPU_GPU inline Float Gaussian(Float x, Float u, Float sigma) {
     return 1 / ::sqrt(2 * Pi * sigma * sigma) *
@@ -194,6 +218,48 @@ RAYFLOW_CPU_GPU inline Float GaussianIntegral(Float x0, Float x1, Float u, Float
     return 0.5f * (::erf((u - x0) / sigmaRoot2) - ::erf((u - x1) / sigmaRoot2));
 }
 
+// 64 bit finalizer of splitmix64, https://xorshift.di.unimi.it/splitmix64.c
+RAYFLOW_CPU_GPU inline uint64_t MixBits(uint64_t v) {
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ULL;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dULL;
+    v ^= v >> 33;
+    return v;
+}
+
+// inverse of the error function, https://github.com/mmp/pbrt-v3/blob/master/src/core/pbrt.h
+inline Float ErfInv(Float x) {
+    Float w, p;
+    x = Clamp(x, -.99999f, .99999f);
+    w = -::log((1 - x) * (1 + x));
+    if (w < 5) {
+        w = w - 2.5f;
+        p = 2.81022636e-08f;
+        p = 3.43273939e-07f + p * w;
+        p = -3.5233877e-06f + p * w;
+        p = -4.39150654e-06f + p * w;
+        p = 0.00021858087f + p * w;
+        p = -0.00125372503f + p * w;
+        p = -0.00417768164f + p * w;
+        p = 0.246640727f + p * w;
+        p = 1.50140941f + p * w;
+    }
+    else {
+        w = ::sqrt(w) - 3;
+        p = -0.000200214257f;
+        p = 0.000100950558f + p * w;
+        p = 0.00134934322f + p * w;
+        p = -0.00367342844f + p * w;
+        p = 0.00573950773f + p * w;
+        p = -0.0076224613f + p * w;
+        p = 0.00943887047f + p * w;
+        p = 1.00167406f + p * w;
+        p = 2.83297682f + p * w;
+    }
+    return p * x;
+}
+
 template <typename Pred>
 inline int FindInterval(int size, const Pred& pred) {
     int left = 0;
@@ -22,6 +22,16 @@ public:
     , tbb::auto_partitioner());});
     }
 
+    // runs task on consecutive ranges [begin, end) of at most chunkSize elements
+    static void Parallel1D(int count, int chunkSize, std::function<void(int, int)> task) {
+        tbb::task_arena arena;
+        arena.execute([&](){tbb::parallel_for(tbb::blocked_range<int>(0, count, chunkSize),
+        [=](const tbb::blocked_range<int>& r) {
+        task(r.begin(), r.end());
+    }
+    , tbb::simple_partitioner());});
+    }
+
     static Scheduler* GetInstance() {
         return mSchedulerInstance;
     }
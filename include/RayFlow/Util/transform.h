@@ -113,7 +113,17 @@ public:
 	}
 
 	RAYFLOW_CPU_GPU Ray operator()(const Ray& ray) const {
-		return Ray((*this)(ray.o), (*this)(ray.d));
+		Ray result((*this)(ray.o), (*this)(ray.d));
+
+		if (ray.hasDifferentials) {
+			result.hasDifferentials = true;
+			result.rxOrigin = (*this)(ray.rxOrigin);
+			result.ryOrigin = (*this)(ray.ryOrigin);
+			result.rxDirection = (*this)(ray.rxDirection);
+			result.ryDirection = (*this)(ray.ryDirection);
+		}
+
+		return result;
 	}
 
 	RAYFLOW_CPU_GPU AABB3 operator()(const AABB3& box) const {
@@ -103,6 +103,131 @@ namespace rayflow
         return result;
     }
 
+    bool BVH::IntersectP(const Ray &ray, Float tMax) const
+    {
+        Vector3 invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+        int isDirNeg[3];
+        isDirNeg[0] = ray.d.x < 0 ? 1 : 0;
+        isDirNeg[1] = ray.d.y < 0 ? 1 : 0;
+        isDirNeg[2] = ray.d.z < 0 ? 1 : 0;
+
+        int currentNodeIndex = 0;
+        int toVisitOffset = 0;
+        int nodeToVisit[128];
+
+        while (true)
+        {
+            const BVHNode &node = mNodes_[currentNodeIndex];
+
+            if (rayflow::Intersect(node.bounds, ray.o, ray.d, invDir, isDirNeg, tMax))
+            {
+                if (node.type == BVHNode::NodeType::Interior)
+                {
+                    nodeToVisit[toVisitOffset++] = node.rightChild;
+                    currentNodeIndex = node.leftChild;
+                    continue;
+                }
+
+                for (int i = 0; i < node.nPrimitives; ++i)
+                {
+                    if (mOrderedPrimitives_[node.startIndex + i].Intersect(ray, tMax))
+                    {
+                        return true;
+                    }
+                }
+            }
+
+            if (toVisitOffset == 0)
+            {
+                break;
+            }
+
+            currentNodeIndex = nodeToVisit[--toVisitOffset];
+        }
+
+        return false;
+    }
+
+    void BVH::IntersectP(const Ray *rays, const Float *tMax, int count, bool *occluded) const
+    {
+        Vector3 invDir[PacketSize];
+        int isDirNeg[PacketSize][3];
+        // rays without a hit so far
+        uint32_t active = 0;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Vector3 &d = rays[i].d;
+            invDir[i] = Vector3(1 / d.x, 1 / d.y, 1 / d.z);
+            isDirNeg[i][0] = d.x < 0 ? 1 : 0;
+            isDirNeg[i][1] = d.y < 0 ? 1 : 0;
+            isDirNeg[i][2] = d.z < 0 ? 1 : 0;
+            occluded[i] = false;
+            active |= 1u << i;
+        }
+
+        int currentNodeIndex = 0;
+        uint32_t currentMask = active;
+        int toVisitOffset = 0;
+        int nodeToVisit[128];
+        uint32_t maskToVisit[128];
+
+        while (true)
+        {
+            const BVHNode &node = mNodes_[currentNodeIndex];
+            uint32_t hitMask = 0;
+
+            for (int i = 0; i < count; ++i)
+            {
+                if ((currentMask & active & (1u << i)) &&
+                    rayflow::Intersect(node.bounds, rays[i].o, rays[i].d, invDir[i], isDirNeg[i], tMax[i]))
+                {
+                    hitMask |= 1u << i;
+                }
+            }
+
+            if (hitMask != 0)
+            {
+                if (node.type == BVHNode::NodeType::Interior)
+                {
+                    nodeToVisit[toVisitOffset] = node.rightChild;
+                    maskToVisit[toVisitOffset++] = hitMask;
+                    currentNodeIndex = node.leftChild;
+                    currentMask = hitMask;
+                    continue;
+                }
+
+                for (int p = 0; p < node.nPrimitives; ++p)
+                {
+                    const Primitive &primitive = mOrderedPrimitives_[node.startIndex + p];
+
+                    for (int i = 0; i < count; ++i)
+                    {
+                        if ((hitMask & active & (1u << i)) && primitive.Intersect(rays[i], tMax[i]))
+                        {
+                            occluded[i] = true;
+                            active &= ~(1u << i);
+                        }
+                    }
+                }
+
+                if (active == 0)
+                {
+                    return;
+                }
+            }
+
+            if (toVisitOffset == 0)
+            {
+                break;
+            }
+
+            --toVisitOffset;
+            currentNodeIndex = nodeToVisit[toVisitOffset];
+            currentMask = maskToVisit[toVisitOffset];
+        }
+    }
+
     BVHBuildNode *BVH::BuildBVH(const std::vector<Primitive> &primitives,
                                 std::vector<BVHPrimitive>& primInfo,
                                 int start, int end, int *totalNode)
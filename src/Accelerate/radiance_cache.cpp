@@ -0,0 +1,111 @@
+#include <RayFlow/Accelerate/radiance_cache.h>
+
+namespace rayflow {
+
+RadianceCache::RadianceCache(Float cellSize, int minSamples, int capacity) :
+    mInvCellSize_(1 / cellSize),
+    mMinSamples_(std::max(minSamples, 1)) {
+    uint64_t size = 1;
+    while (size < uint64_t(capacity)) {
+        size <<= 1;
+    }
+
+    mMask_ = size - 1;
+    mCells_ = std::vector<Cell>(size);
+}
+
+uint64_t RadianceCache::Key(const Point3& p, const Normal3& n) const {
+    // 20 bits per axis, the grid wraps around far outside of any scene
+    uint64_t x = uint64_t(int64_t(::floor(p.x * mInvCellSize_))) & 0xfffff;
+    uint64_t y = uint64_t(int64_t(::floor(p.y * mInvCellSize_))) & 0xfffff;
+    uint64_t z = uint64_t(int64_t(::floor(p.z * mInvCellSize_))) & 0xfffff;
+
+    int axis = 0;
+    if (std::abs(n.y) > std::abs(n[axis])) {
+        axis = 1;
+    }
+    if (std::abs(n.z) > std::abs(n[axis])) {
+        axis = 2;
+    }
+    uint64_t direction = axis * 2 + (n[axis] < 0 ? 1 : 0);
+
+    return x | (y << 20) | (z << 40) | (direction << 60) | (1ULL << 63);
+}
+
+int RadianceCache::Find(uint64_t key) const {
+    uint64_t hash = MixBits(key);
+
+    for (int i = 0; i < MaxProbes; ++i) {
+        int slot = int((hash + i) & mMask_);
+        uint64_t slotKey = mCells_[slot].key.load(std::memory_order_acquire);
+
+        if (slotKey == key) {
+            return slot;
+        }
+        if (slotKey == 0) {
+            return -1;
+        }
+    }
+
+    return -1;
+}
+
+int RadianceCache::Insert(uint64_t key) {
+    uint64_t hash = MixBits(key);
+
+    for (int i = 0; i < MaxProbes; ++i) {
+        int slot = int((hash + i) & mMask_);
+        uint64_t slotKey = mCells_[slot].key.load(std::memory_order_acquire);
+
+        if (slotKey == 0) {
+            // another thread may claim the slot first, for this key or another one
+            if (mCells_[slot].key.compare_exchange_strong(slotKey, key, std::memory_order_acq_rel)) {
+                return slot;
+            }
+        }
+
+        if (slotKey == key) {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+bool RadianceCache::Lookup(const Point3& p, const Normal3& n, Spectrum* L) const {
+    int slot = Find(Key(p, n));
+
+    if (slot < 0) {
+        return false;
+    }
+
+    const Cell& cell = mCells_[slot];
+    int count = cell.count.load(std::memory_order_relaxed);
+
+    if (count < mMinSamples_) {
+        return false;
+    }
+
+    *L = Spectrum(cell.radiance[0], cell.radiance[1], cell.radiance[2]) / count;
+    return true;
+}
+
+void RadianceCache::AddSample(const Point3& p, const Normal3& n, const Spectrum& L) {
+    if (L.HasNaN() || L.HasINF()) {
+        return;
+    }
+
+    int slot = Insert(Key(p, n));
+
+    if (slot < 0) {
+        return;
+    }
+
+    Cell& cell = mCells_[slot];
+    cell.radiance[0].Add(L[0]);
+    cell.radiance[1].Add(L[1]);
+    cell.radiance[2].Add(L[2]);
+    cell.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
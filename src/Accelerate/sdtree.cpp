@@ -0,0 +1,233 @@
+#include <RayFlow/Accelerate/sdtree.h>
+#include <RayFlow/Util/parallel.h>
+
+namespace rayflow {
+
+void DTree::Record(const Vector3& d, Float irradiance, Float weight) {
+    if (!std::isfinite(irradiance) || irradiance < 0 || weight <= 0) {
+        return;
+    }
+
+    Point2 p = DirectionToCylindrical(d);
+    int nodeIndex = 0;
+
+    while (true) {
+        DTreeNode& node = mNodes_[nodeIndex];
+        int quadrant = DTreeNode::ChildIndex(p);
+        node.sums[quadrant].Add(irradiance * weight);
+
+        if (node.IsLeaf(quadrant)) {
+            break;
+        }
+        nodeIndex = node.children[quadrant];
+    }
+
+    mSampleWeight_.Add(weight);
+}
+
+Float DTree::Pdf(const Vector3& d) const {
+    if (Total() <= 0) {
+        return Inv4Pi;
+    }
+
+    Point2 p = DirectionToCylindrical(d);
+    Float pdf = 1;
+    int nodeIndex = 0;
+
+    while (true) {
+        const DTreeNode& node = mNodes_[nodeIndex];
+        Float sum = node.Sum();
+
+        // statistics of this subtree are empty, it is sampled uniformly
+        if (sum <= 0) {
+            break;
+        }
+
+        int quadrant = DTreeNode::ChildIndex(p);
+        pdf *= 4 * node.sums[quadrant] / sum;
+
+        if (node.IsLeaf(quadrant) || pdf == 0) {
+            break;
+        }
+        nodeIndex = node.children[quadrant];
+    }
+
+    return pdf * Inv4Pi;
+}
+
+Vector3 DTree::Sample(Point2 u) const {
+    if (Total() <= 0) {
+        return CylindricalToDirection(u);
+    }
+
+    Point2 origin(0, 0);
+    Float scale = 1;
+    int nodeIndex = 0;
+
+    while (true) {
+        const DTreeNode& node = mNodes_[nodeIndex];
+        Float sum = node.Sum();
+
+        if (sum <= 0) {
+            break;
+        }
+
+        // pick the column first, then the quadrant inside the column, reusing the remapped u
+        int xBit = 0;
+        Float pLeft = (node.sums[0] + node.sums[2]) / sum;
+        if (u.x < pLeft) {
+            u.x /= pLeft;
+        }
+        else {
+            u.x = (u.x - pLeft) / (1 - pLeft);
+            xBit = 1;
+        }
+
+        int yBit = 0;
+        Float columnSum = node.sums[xBit] + node.sums[xBit | 2];
+        Float pBottom = columnSum > 0 ? node.sums[xBit] / columnSum : 0.5f;
+        if (u.y < pBottom) {
+            u.y /= pBottom;
+        }
+        else {
+            u.y = (u.y - pBottom) / (1 - pBottom);
+            yBit = 1;
+        }
+
+        int quadrant = xBit | (yBit << 1);
+        scale *= 0.5f;
+        origin.x += xBit * scale;
+        origin.y += yBit * scale;
+
+        if (node.IsLeaf(quadrant)) {
+            break;
+        }
+        nodeIndex = node.children[quadrant];
+    }
+
+    Point2 p(Clamp(origin.x + u.x * scale, 0, OneMinusEpsilon),
+             Clamp(origin.y + u.y * scale, 0, OneMinusEpsilon));
+
+    return CylindricalToDirection(p);
+}
+
+DTree DTree::Refined(Float rho, int maxDepth) const {
+    struct RefineEntry {
+        int newIndex;
+        // node of this tree covering the same region, -1 if it was a leaf quadrant
+        int oldIndex;
+        Float oldSum;
+        int depth;
+    };
+
+    DTree result;
+    Float total = Total();
+    std::vector<RefineEntry> stack;
+    stack.push_back({ 0, 0, total, 1 });
+
+    while (!stack.empty()) {
+        RefineEntry entry = stack.back();
+        stack.pop_back();
+
+        for (int quadrant = 0; quadrant < 4; ++quadrant) {
+            Float sum = entry.oldIndex >= 0 ? Float(mNodes_[entry.oldIndex].sums[quadrant]) : entry.oldSum * 0.25f;
+            Float fraction = total > 0 ? sum / total : std::pow(0.25f, entry.depth);
+
+            if (entry.depth >= maxDepth || fraction <= rho) {
+                continue;
+            }
+
+            int child = result.mNodes_.size();
+            result.mNodes_.emplace_back();
+            result.mNodes_[entry.newIndex].children[quadrant] = child;
+
+            int oldChild = -1;
+            if (entry.oldIndex >= 0 && !mNodes_[entry.oldIndex].IsLeaf(quadrant)) {
+                oldChild = mNodes_[entry.oldIndex].children[quadrant];
+            }
+
+            stack.push_back({ child, oldChild, sum, entry.depth + 1 });
+        }
+    }
+
+    return result;
+}
+
+SDTree::SDTree(const AABB3& bounds) {
+    // a cube keeps the spatial cells well shaped when splitting along alternating axes
+    Vector3 diag = bounds.Diagonal();
+    Float size = std::max(diag.x, std::max(diag.y, diag.z));
+    mBounds_ = AABB3(bounds.pMin, bounds.pMin + Vector3(size, size, size));
+
+    STreeNode root;
+    root.dTreeIndex = 0;
+    mNodes_.push_back(root);
+    mDTrees_.emplace_back();
+}
+
+DTreeWrapper* SDTree::Lookup(const Point3& p) {
+    Vector3 diag = mBounds_.Diagonal();
+    Point3 u;
+    for (int i = 0; i < 3; ++i) {
+        u[i] = diag[i] > 0 ? Clamp((p[i] - mBounds_.pMin[i]) / diag[i], 0, OneMinusEpsilon) : 0;
+    }
+
+    int nodeIndex = 0;
+    while (!mNodes_[nodeIndex].isLeaf) {
+        const STreeNode& node = mNodes_[nodeIndex];
+        int axis = node.axis;
+
+        if (u[axis] < 0.5f) {
+            u[axis] *= 2;
+            nodeIndex = node.children[0];
+        }
+        else {
+            u[axis] = (u[axis] - 0.5f) * 2;
+            nodeIndex = node.children[1];
+        }
+    }
+
+    return &mDTrees_[mNodes_[nodeIndex].dTreeIndex];
+}
+
+void SDTree::Subdivide(int nodeIndex) {
+    STreeNode parent = mNodes_[nodeIndex];
+    int firstChild = mNodes_.size();
+
+    // both halves start from the parent's distribution, each owning half of its samples
+    mDTrees_[parent.dTreeIndex].building.ScaleSampleWeight(0.5f);
+    mDTrees_.push_back(mDTrees_[parent.dTreeIndex]);
+
+    for (int i = 0; i < 2; ++i) {
+        STreeNode child;
+        child.axis = (parent.axis + 1) % 3;
+        child.dTreeIndex = i == 0 ? parent.dTreeIndex : mDTrees_.size() - 1;
+        mNodes_.push_back(child);
+    }
+
+    STreeNode& node = mNodes_[nodeIndex];
+    node.isLeaf = false;
+    node.children[0] = firstChild;
+    node.children[1] = firstChild + 1;
+    node.dTreeIndex = -1;
+}
+
+void SDTree::Refine(Float spatialThreshold, Float rho, int maxDepth) {
+    // children are appended behind their parent, so one sweep also visits the new leaves
+    if (spatialThreshold > 0) {
+        for (size_t i = 0; i < mNodes_.size(); ++i) {
+            if (mNodes_[i].isLeaf &&
+                mDTrees_[mNodes_[i].dTreeIndex].building.SampleWeight() > spatialThreshold) {
+                Subdivide(int(i));
+            }
+        }
+    }
+
+    tbb::parallel_for(0, (int)mDTrees_.size(), [&](int i) {
+        DTreeWrapper& dTree = mDTrees_[i];
+        dTree.sampling = dTree.building;
+        dTree.building = dTree.sampling.Refined(rho, maxDepth);
+    });
+}
+
+}
@@ -1,4 +1,5 @@
 #include <RayFlow/Core/integrator.h>
+#include <RayFlow/Render/samplers.h>
 #include <algorithm>
 
 namespace rayflow {
@@ -6,6 +7,12 @@ namespace rayflow {
 void SamplingIntegrator::Render(const Scene& scene) {
     Preprocess(scene, *mSampler_);
 
+    RenderPass(scene, 0, mSampler_->GetSampleCount());
+
+    mCamera_->mFilm_->Write();
+}
+
+void SamplingIntegrator::RenderPass(const Scene& scene, int passIndex, size_t sampleCount) {
     Film* film = mCamera_->mFilm_;
     Point2i resolution = film->resolution;
     AABB2i sampledBounds = mCamera_->mSampleBounds_;
@@ -14,64 +21,118 @@ void SamplingIntegrator::Render(const Scene& scene) {
     int tileXCount = ((resolution.x + filmTileWidth - 1) / filmTileWidth);
     int tileYCount = ((resolution.y + filmTileWidth - 1) / filmTileWidth);
     Point2i tileCount(tileXCount, tileYCount);
+    sampleCount = std::min<size_t>(sampleCount, mSampler_->GetSampleCount());
 
     Scheduler::Parallel2D(tileCount,
         [&](Point2i tile) {
             ResetGMalloc();
 
-            int seed = tile.y * tileCount.x + tile.x;
-            Sampler* sampler = mSampler_->Clone(seed);
+            int seed = (passIndex * tileCount.y + tile.y) * tileCount.x + tile.x;
+            Sampler* sampler = mSampler_->ClonePass(seed, passIndex);
 
             int x0 = sampledBounds.pMin.x + tile.x * filmTileWidth;
             int x1 = std::min<int>(x0 + filmTileWidth, sampledBounds.pMax.x);
             int y0 = sampledBounds.pMin.y + tile.y * filmTileWidth;
             int y1 = std::min<int>(y0 + filmTileWidth, sampledBounds.pMax.y);
-            FilmTile* filmTile = film->GetFilmTile(AABB2i(Point2i(x0, y0), Point2i(x1, y1)));
-
-            for (int y = y0; y < y1; ++y) {
-                for (int x = x0; x < x1; ++x) {
-                    Point2i pRaster(x, y);
-                    size_t sampleCount = sampler->GetSampleCount();
-                    sampler->StartPixel(pRaster);
-                    //if (x == 409 && y == 477) {
-                    //    std::cout << 1 << std::endl;
-                    //}
-                    //else {
-                    //    continue;
-                    //}
-                    for (int i = 0; i < sampleCount; ++i) {
-                        Point2 pFilm = Point2(pRaster) + sampler->Get2D();
-                        CameraRaySample raySample = mCamera_->GenerateRay(pFilm, sampler->Get2D());
-                        Spectrum L = raySample.weight * Li(raySample.ray, scene, *sampler);
-
-                        if (L.HasNaN()) {
-
-                            std::cout << "Not-a-number radiance value returned for pixel ("
-                                << x << "," << y << "), sample" << (int)sampler->GetCurrentSampleNumber()
-                                << ".Setting to black.\n";
-
-                            L = Spectrum(0.f);
-                        }
-                        else if (L.HasINF()) {
-                            std::cout << "Not-a-number radiance value returned for pixel ("
-                                << x << "," << y << "), sample" << (int)sampler->GetCurrentSampleNumber()
-                                << ".Setting to black.\n";
-                            L = Spectrum(0.f);
-                        }
-
-                        filmTile->AddSample(pFilm, L);
-
-                        sampler->Advance();
-                        //ResetGMalloc();
-                    }
-                }
-            }
+            AABB2i pixelBounds(Point2i(x0, y0), Point2i(x1, y1));
+            FilmTile* filmTile = film->GetFilmTile(pixelBounds);
+
+            RenderTile(scene, *sampler, filmTile, pixelBounds, sampleCount, seed);
 
             film->MergeFilmTile(filmTile);
+            delete sampler;
         }
     );
+}
+
+AOVSample FirstHitAOVs(const Scene& scene, const SurfaceIntersection& si, Float depth, Sampler& sampler) {
+    AOVSample aov;
+    aov.normal = si.ns;
+    aov.depth = depth;
+    aov.primitiveId = scene.PrimitiveId(si);
+    aov.materialId = scene.MaterialId(si);
 
-    film->Write();
+    auto bsdf = si.EvaluateBSDF();
+
+    if (bsdf) {
+        auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+
+        if (bsdfSample && bsdfSample->pdf > 0) {
+            aov.albedo = bsdfSample->f * AbsDot(bsdfSample->wi, si.ns) / bsdfSample->pdf;
+        }
+    }
+
+    return aov;
+}
+
+Float CameraRayDifferentialScale(size_t samplesPerPixel) {
+    return std::max<Float>(0.125f, 1 / std::sqrt(Float(std::max<size_t>(samplesPerPixel, 1))));
+}
+
+void SamplingIntegrator::RenderTile(const Scene& scene, Sampler& sampler, FilmTile* filmTile,
+                                    const AABB2i& pixelBounds, size_t sampleCount, uint64_t seed) {
+    // the feature buffers draw their own samples so the image is the same with and without them
+    RandomSampler aovSampler(1, seed);
+    Float differentialScale = CameraRayDifferentialScale(sampleCount);
+    const Film* film = mCamera_->mFilm_;
+    bool filterSampling = film->FilterSampling();
+
+    for (int y = pixelBounds.pMin.y; y < pixelBounds.pMax.y; ++y) {
+        for (int x = pixelBounds.pMin.x; x < pixelBounds.pMax.x; ++x) {
+            Point2i pRaster(x, y);
+            sampler.StartPixel(pRaster);
+            //if (x == 409 && y == 477) {
+            //    std::cout << 1 << std::endl;
+            //}
+            //else {
+            //    continue;
+            //}
+            for (int i = 0; i < sampleCount; ++i) {
+                // with filter sampling the ray may leave the pixel but the sample still belongs to it
+                Point2 pFilm = Point2(pRaster) + sampler.Get2D();
+                Float filterWeight = 1;
+                if (filterSampling) {
+                    FilterSample fs = film->GetFilter()->Sample(pFilm - Vector2(pRaster));
+                    pFilm = Point2(pRaster) + Vector2(0.5f, 0.5f) + fs.p;
+                    filterWeight = fs.weight;
+                }
+                CameraRaySample raySample = mCamera_->GenerateRay(pFilm, sampler.Get2D());
+                raySample.ray.ScaleDifferentials(differentialScale);
+                Spectrum L = raySample.weight * Li(raySample.ray, scene, sampler);
+
+                if (filmTile->HasAOVs()) {
+                    auto hit = scene.Intersect(raySample.ray);
+                    Point2 pAOV = filterSampling ? Point2(pRaster) + Vector2(0.5f, 0.5f) : pFilm;
+                    filmTile->AddAOVSample(pAOV, hit ? FirstHitAOVs(scene, hit->isect, hit->tHit, aovSampler) : AOVSample());
+                }
+
+                if (L.HasNaN()) {
+
+                    std::cout << "Not-a-number radiance value returned for pixel ("
+                        << x << "," << y << "), sample" << (int)sampler.GetCurrentSampleNumber()
+                        << ".Setting to black.\n";
+
+                    L = Spectrum(0.f);
+                }
+                else if (L.HasINF()) {
+                    std::cout << "Not-a-number radiance value returned for pixel ("
+                        << x << "," << y << "), sample" << (int)sampler.GetCurrentSampleNumber()
+                        << ".Setting to black.\n";
+                    L = Spectrum(0.f);
+                }
+
+                if (filterSampling) {
+                    filmTile->AddPixelSample(pRaster, L, filterWeight);
+                }
+                else {
+                    filmTile->AddSample(pFilm, L);
+                }
+
+                sampler.Advance();
+                //ResetGMalloc();
+            }
+        }
+    }
 }
 
 }
\ No newline at end of file
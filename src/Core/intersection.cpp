@@ -20,6 +20,67 @@ rstd::optional<BSDF> SurfaceIntersection::EvaluateBSDF(TransportMode mode) const
     return material->EvaluateBSDF(*this, mode);
 }
 
+void SurfaceIntersection::ComputeDifferentials(const Ray& ray) {
+    dudx = dvdx = dudy = dvdy = 0;
+
+    if (!ray.hasDifferentials || LengthSquare(Cross(dpdu, dpdv)) == 0) {
+        return;
+    }
+
+    // offset rays hit the tangent plane of the hit point
+    Vector3 n(ng);
+    Float d = Dot(n, Vector3(p));
+    Float denomX = Dot(n, ray.rxDirection);
+    Float denomY = Dot(n, ray.ryDirection);
+
+    if (denomX == 0 || denomY == 0) {
+        return;
+    }
+
+    Float tx = -(Dot(n, Vector3(ray.rxOrigin)) - d) / denomX;
+    Float ty = -(Dot(n, Vector3(ray.ryOrigin)) - d) / denomY;
+
+    if (std::isinf(tx) || std::isnan(tx) || std::isinf(ty) || std::isnan(ty)) {
+        return;
+    }
+
+    Vector3 dpdx = (ray.rxOrigin + tx * ray.rxDirection) - p;
+    Vector3 dpdy = (ray.ryOrigin + ty * ray.ryDirection) - p;
+
+    // least squares in the two axes the normal is least aligned with
+    int dim[2];
+    if (std::abs(n.x) > std::abs(n.y) && std::abs(n.x) > std::abs(n.z)) {
+        dim[0] = 1;
+        dim[1] = 2;
+    }
+    else if (std::abs(n.y) > std::abs(n.z)) {
+        dim[0] = 0;
+        dim[1] = 2;
+    }
+    else {
+        dim[0] = 0;
+        dim[1] = 1;
+    }
+
+    Float a00 = dpdu[dim[0]], a01 = dpdv[dim[0]];
+    Float a10 = dpdu[dim[1]], a11 = dpdv[dim[1]];
+    Float det = a00 * a11 - a01 * a10;
+
+    if (std::abs(det) < 1e-12f) {
+        return;
+    }
+
+    Float invDet = 1 / det;
+    dudx = (a11 * dpdx[dim[0]] - a01 * dpdx[dim[1]]) * invDet;
+    dvdx = (a00 * dpdx[dim[1]] - a10 * dpdx[dim[0]]) * invDet;
+    dudy = (a11 * dpdy[dim[0]] - a01 * dpdy[dim[1]]) * invDet;
+    dvdy = (a00 * dpdy[dim[1]] - a10 * dpdy[dim[0]]) * invDet;
+
+    if (std::isnan(dudx) || std::isnan(dvdx) || std::isnan(dudy) || std::isnan(dvdy)) {
+        dudx = dvdx = dudy = dvdy = 0;
+    }
+}
+
 const AreaLight* SurfaceIntersection::GetAreaLight() const {
     return primitive ? primitive->GetAreaLight() : nullptr;
 }
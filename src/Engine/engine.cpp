@@ -236,14 +236,8 @@ namespace rayflow
 				mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &texName);
 				std::string imgPath = objPath + "/" + texName.C_Str();
 
-				if (mImages_.find(imgPath) == mImages_.end())
-				{
-					mImages_[imgPath] = mAlloc_.new_object<BitMap>(imgPath, false);
-				}
 				TextureMapping* mapping = mAlloc_.new_object<UVMapping>();
-				Kd = mAlloc_.new_object<ImageTexture<Spectrum>>(mapping, mImages_[imgPath],
-					ImageTextureWrapMode::REPEAT,
-					ImageTextureFilterType::BILINEAR);
+				Kd = mAlloc_.new_object<ImageTexture<Spectrum>>(mapping, GetMIPMap(imgPath, imgPath));
 			}
 			else
 			{
@@ -264,14 +258,8 @@ namespace rayflow
 				mMaterials[i]->GetTexture(aiTextureType_DIFFUSE, 0, &texName);
 				std::string imgPath = objPath + "/" + texName.C_Str();
 
-				if (mImages_.find(imgPath) == mImages_.end())
-				{
-					mImages_[imgPath] = mAlloc_.new_object<BitMap>(imgPath, false);
-				}
 				TextureMapping* mapping = mAlloc_.new_object<UVMapping>();
-				Ks = mAlloc_.new_object<ImageTexture<Spectrum>>(mapping, mImages_[imgPath],
-					ImageTextureWrapMode::REPEAT,
-					ImageTextureFilterType::BILINEAR);
+				Ks = mAlloc_.new_object<ImageTexture<Spectrum>>(mapping, GetMIPMap(imgPath, imgPath));
 			}
 			else
 			{
@@ -397,16 +385,45 @@ namespace rayflow
 		}
 	}
 
-	bool RayFlowEngine::Init(const std::string& filename)
+	bool RayFlowEngine::Init(const std::string& filename, const std::string& integratorType)
 	{
-		ConfigFileParser parser(this);
+		ConfigFileParser parser(this, integratorType);
 		return parser.Parse(filename);
 	}
 
+	MIPMap* RayFlowEngine::GetMIPMap(const std::string& name, const std::string& filename)
+	{
+		auto it = mMIPMaps_.find(name);
+		if (it != mMIPMaps_.end())
+		{
+			return it->second;
+		}
+
+		MIPMap* mipmap = nullptr;
+		int textureId = mTextureCache_ ? mTextureCache_->AddTexture(filename) : -1;
+		if (textureId >= 0)
+		{
+			mipmap = mAlloc_.new_object<MIPMap>(mTextureCache_, textureId);
+		}
+		else
+		{
+			// the decoded image is only needed to build the pyramid
+			BitMap bitmap(filename, false);
+			mipmap = mAlloc_.new_object<MIPMap>(MIPMap(bitmap));
+		}
+
+		mMIPMaps_[name] = mipmap;
+		return mipmap;
+	}
+
 	void RayFlowEngine::Render()
 	{
 		Timer timer;
 		mIntegrator_->Render(*mScene_);
+		if (mTextureCache_)
+		{
+			mTextureCache_->PrintStatistics();
+		}
 		//ReadScene("C:/FlowSource/code/FlowLab/RayFlow/resources/cornell-box-monster/cornell-box.xml");
 		/*
 		BitMap testMap("C:/FlowSource/code/FlowLab/RayFlow/resources/cornell-box/cornell-box.png", false);
@@ -1,7 +1,158 @@
 #include "RayFlow/Engine/parse.h"
+#include "RayFlow/Util/parallel.h"
+
+#include <unordered_set>
 
 namespace rayflow
 {
+    void ConfigFileParser::ConvertObj(const tinyobj::attrib_t &attrib, const std::vector<tinyobj::shape_t> &shapes, ObjAsset &asset)
+    {
+        const auto &vData = attrib.vertices;
+        const auto &nData = attrib.normals;
+        const auto &texData = attrib.texcoords;
+        size_t indexCount = 0;
+
+        for (const auto &shape : shapes)
+        {
+            indexCount += shape.mesh.indices.size();
+        }
+
+        asset.positions.reserve(vData.size() / 3);
+        asset.normals.reserve(nData.size() / 3);
+        asset.texCoords.reserve(texData.size() / 2);
+        asset.fid.reserve(indexCount * 3);
+
+        for (size_t i = 0; i < vData.size(); i += 3)
+        {
+            asset.positions.push_back(Point3(Float(vData[i]), Float(vData[i + 1]), Float(vData[i + 2])));
+        }
+
+        for (size_t i = 0; i < nData.size(); i += 3)
+        {
+            asset.normals.push_back(Normal3(Float(nData[i]), Float(nData[i + 1]), Float(nData[i + 2])));
+        }
+
+        for (size_t i = 0; i < texData.size(); i += 2)
+        {
+            asset.texCoords.push_back(Point2(Float(texData[i]), Float(texData[i + 1])));
+        }
+
+        // the groups of the file index into the same pool, their faces are simply concatenated
+        for (const auto &shape : shapes)
+        {
+            for (const auto &idx : shape.mesh.indices)
+            {
+                asset.fid.push_back(idx.vertex_index);
+                asset.fid.push_back(idx.normal_index);
+                asset.fid.push_back(idx.texcoord_index);
+            }
+        }
+    }
+
+    void ConfigFileParser::LoadAssets(tinyxml2::XMLElement *sceneNode)
+    {
+        std::vector<std::string> objFiles;
+        std::unordered_set<std::string> objFileSet;
+
+        for (tinyxml2::XMLElement *shapeNode = sceneNode->FirstChildElement("shape"); shapeNode; shapeNode = shapeNode->NextSiblingElement("shape"))
+        {
+            if (strcmp(shapeNode->Attribute("type"), "obj") == 0)
+            {
+                std::string filepath = assetPath + shapeNode->FirstChildElement()->Attribute("value");
+                if (objFileSet.insert(filepath).second)
+                {
+                    objFiles.push_back(filepath);
+                }
+            }
+        }
+
+        // <texture><string value="..."/></texture> anywhere inside a bsdf, the names ParseRGBTexture looks up
+        std::vector<std::string> textureNames;
+        if (engine->mTextureCache_ == nullptr)
+        {
+            std::unordered_set<std::string> textureNameSet;
+            std::vector<tinyxml2::XMLElement *> stack;
+
+            for (tinyxml2::XMLElement *bsdfNode = sceneNode->FirstChildElement("bsdf"); bsdfNode; bsdfNode = bsdfNode->NextSiblingElement("bsdf"))
+            {
+                stack.push_back(bsdfNode);
+            }
+
+            while (!stack.empty())
+            {
+                tinyxml2::XMLElement *node = stack.back();
+                stack.pop_back();
+                tinyxml2::XMLElement *nameNode = node->FirstChildElement("string");
+
+                if (strcmp(node->Name(), "texture") == 0 && nameNode && nameNode->Attribute("value"))
+                {
+                    std::string texname = nameNode->Attribute("value");
+                    if (engine->mMIPMaps_.find(texname) == engine->mMIPMaps_.end() && textureNameSet.insert(texname).second)
+                    {
+                        textureNames.push_back(texname);
+                    }
+                }
+
+                for (tinyxml2::XMLElement *child = node->FirstChildElement(); child; child = child->NextSiblingElement())
+                {
+                    stack.push_back(child);
+                }
+            }
+        }
+
+        // the allocator is not thread safe, the pyramids are moved into it afterwards
+        std::vector<std::unique_ptr<ObjAsset>> objs(objFiles.size());
+        std::vector<std::unique_ptr<MIPMap>> mipmaps(textureNames.size());
+        int objCount = int(objFiles.size());
+
+        Scheduler::Parallel1D(objCount + int(textureNames.size()), 1,
+            [&](int begin, int end)
+            {
+                for (int i = begin; i < end; ++i)
+                {
+                    if (i < objCount)
+                    {
+                        auto asset = std::make_unique<ObjAsset>();
+                        tinyobj::attrib_t attrib;
+                        std::vector<tinyobj::shape_t> shapes;
+                        std::vector<tinyobj::material_t> materials;
+                        asset->loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &asset->warning,
+                                                         &asset->error, objFiles[i].c_str());
+                        ConvertObj(attrib, shapes, *asset);
+                        objs[i] = std::move(asset);
+                    }
+                    else
+                    {
+                        int t = i - objCount;
+                        // the decoded image is only needed to build the pyramid
+                        BitMap bitmap(assetPath + textureNames[t], false);
+                        mipmaps[t] = std::make_unique<MIPMap>(bitmap);
+                    }
+                }
+            }
+        );
+
+        for (int i = 0; i < objCount; ++i)
+        {
+            if (!objs[i]->warning.empty())
+            {
+                std::cout << objs[i]->warning << std::endl;
+            }
+
+            if (!objs[i]->error.empty())
+            {
+                std::cerr << objs[i]->error << std::endl;
+            }
+
+            objAssets[objFiles[i]] = std::move(objs[i]);
+        }
+
+        for (size_t t = 0; t < textureNames.size(); ++t)
+        {
+            engine->AddMIPMap(textureNames[t], engine->mAlloc_.new_object<MIPMap>(std::move(*mipmaps[t])));
+        }
+    }
+
     bool ConfigFileParser::Parse(const std::string &filename)
     {
         Allocator &allocator = engine->mAlloc_;
@@ -20,7 +171,7 @@ namespace rayflow
 
         // default
         tinyxml2::XMLElement *defaultNode = sceneNode->FirstChildElement("default");
-        std::string integratorType = defaultNode->Attribute("value");
+        std::string integratorType = integratorOverride.empty() ? defaultNode->Attribute("value") : integratorOverride;
         defaultNode = defaultNode->NextSiblingElement();
         int spp = ParseNumber<int>(defaultNode->Attribute("value"));
         defaultNode = defaultNode->NextSiblingElement();
@@ -29,6 +180,10 @@ namespace rayflow
         int resx = ParseNumber<int>(defaultNode->Attribute("value"));
         defaultNode = defaultNode->NextSiblingElement();
         int maxDepth = ParseNumber<int>(defaultNode->Attribute("value"));
+        LightSamplerType lightSamplerType = ParseLightSamplerType(FindDefault(sceneNode, "lightsampler"));
+        // resampled direct lighting, 0 candidates keeps plain next event estimation
+        int lightCandidates = FindDefaultNumber<int>(sceneNode, "lightcandidates", 0);
+        int spatialReuse = FindDefaultNumber<int>(sceneNode, "spatialreuse", 0);
 
         printf("Integrator: %s\nspp: %d\nresx: %d\nresy: %d\nmax depth:%d\n", integratorType.c_str(), spp, resx, resy, maxDepth);
 
@@ -39,9 +194,44 @@ namespace rayflow
         Transform *worldToCamera = allocator.new_object<Transform>(Inverse(*cameraToWorld));
         Point2i resolution(resx, resy);
         AABB2i filmBounds = AABB2i(Point2i(0, 0), Point2i(resx, resy));
-        Filter *filter = allocator.new_object<BoxFilter>();
-        Film *film = allocator.new_object<Film>(filmBounds, resolution, filter, "a.png", allocator);
+        Filter *filter = nullptr;
+        const char *filterType = FindDefault(sceneNode, "filter");
+        if (filterType && strcmp(filterType, "gaussian") == 0)
+        {
+            Float filterRadius = FindDefaultNumber<Float>(sceneNode, "filterradius", 1.5f);
+            filter = allocator.new_object<GaussianFilter>(Vector2(filterRadius, filterRadius));
+        }
+        else
+        {
+            filter = allocator.new_object<BoxFilter>();
+        }
+        // merged tiles go to disk instead of a full frame of pixels, for resolutions that do not fit in memory
+        bool streamFilm = FindDefaultNumber<int>(sceneNode, "streamfilm", 0) != 0;
+        Film *film = allocator.new_object<Film>(filmBounds, resolution, filter, "a.png", allocator, streamFilm);
+        // an .exr image keeps the linear radiance, the AOVs go into <image>_aovs.exr
+        if (const char *output = FindDefault(sceneNode, "output"))
+        {
+            film->SetFilename(output);
+        }
+        // albedo, normal, depth, id and sample count buffers, the denoiser is guided by them
+        bool denoise = FindDefaultNumber<int>(sceneNode, "denoise", 0) != 0;
+        if (denoise || FindDefaultNumber<int>(sceneNode, "aovs", 0) != 0)
+        {
+            film->EnableAOVs();
+        }
+        if (denoise)
+        {
+            film->SetDenoiser(allocator.new_object<Denoiser>());
+        }
         engine->AddFilm(film);
+        // image textures are paged in as tiles under a budget in MB instead of being decoded while parsing
+        int textureCacheSize = FindDefaultNumber<int>(sceneNode, "texturecache", 0);
+        if (textureCacheSize > 0)
+        {
+            const char *textureCacheDirectory = FindDefault(sceneNode, "texturecachedir");
+            engine->SetTextureCache(allocator.new_object<TextureCache>(size_t(textureCacheSize) << 20,
+                                                                       textureCacheDirectory ? textureCacheDirectory : ""));
+        }
         AABB2 screenWindow;
 
         if (resx > resy)
@@ -58,20 +248,117 @@ namespace rayflow
         Camera *camera = allocator.new_object<PerspectiveCamera>(cameraToWorld, resolution, filmBounds, screenWindow, 0.0f, 1.0f, fov, film);
         engine->AddCamera(camera);
         // integrator
-        int xSamples = static_cast<int>(std::sqrt(spp));
-        Sampler *sampler = allocator.new_object<StratifiedSampler>(xSamples, xSamples, 12, true);
+        Sampler *sampler = nullptr;
+        const char *samplerType = FindDefault(sceneNode, "sampler");
+        if (samplerType && strcmp(samplerType, "sobol") == 0)
+        {
+            sampler = allocator.new_object<SobolSampler>(spp);
+        }
+        else if (samplerType && strcmp(samplerType, "pmj02") == 0)
+        {
+            sampler = allocator.new_object<PMJ02Sampler>(spp);
+        }
+        else if (samplerType && strcmp(samplerType, "zsobol") == 0)
+        {
+            sampler = allocator.new_object<ZSobolSampler>(spp, resolution);
+        }
+        else
+        {
+            // the most square grid with exactly spp cells
+            int ySamples = static_cast<int>(std::sqrt(spp));
+            while (ySamples > 1 && spp % ySamples != 0)
+            {
+                --ySamples;
+            }
+            ySamples = std::max(ySamples, 1);
+            int xSamples = std::max(spp / ySamples, 1);
+            sampler = allocator.new_object<StratifiedSampler>(xSamples, ySamples, 12, true);
+        }
 
         Integrator *integrator = nullptr;
         if (integratorType == "path")
         {
-            integrator = allocator.new_object<PathTracerIntegrator>(camera, sampler, maxDepth);
+            // radiance cache for indirect diffuse light, 0 samples per cell disables it
+            int cacheSamples = FindDefaultNumber<int>(sceneNode, "cachesamples", 0);
+            Float cacheCellSize = FindDefaultNumber<Float>(sceneNode, "cachecellsize", 0);
+            integrator = allocator.new_object<PathTracerIntegrator>(camera, sampler, maxDepth, 3, false, lightCandidates,
+                                                                    cacheSamples, cacheCellSize);
+        }
+        else if (integratorType == "direct")
+        {
+            integrator = allocator.new_object<DirectIntegrator>(camera, sampler, lightCandidates, spatialReuse);
         }
         else if (integratorType == "bdpt")
         {
-            integrator = allocator.new_object<BDPTIntegrator>(camera, sampler, maxDepth);
+            int lightPathConnections = FindDefaultNumber<int>(sceneNode, "lightpathconnections", 0);
+            Float shadowRR = FindDefaultNumber<Float>(sceneNode, "shadowrr", 0);
+            integrator = allocator.new_object<BDPTIntegrator>(camera, sampler, maxDepth, false, lightPathConnections, shadowRR);
+        }
+        else if (integratorType == "sppm")
+        {
+            // spp is the number of camera and photon passes
+            int photons = FindDefaultNumber<int>(sceneNode, "photons", resx * resy);
+            Float radius = FindDefaultNumber<Float>(sceneNode, "radius", 0);
+            integrator = allocator.new_object<SPPMIntegrator>(camera, sampler, spp, photons, maxDepth, radius);
+        }
+        else if (integratorType == "guided")
+        {
+            integrator = allocator.new_object<GuidedPathTracerIntegrator>(camera, sampler, maxDepth);
+        }
+        else if (integratorType == "vcm")
+        {
+            // spp is the number of iterations, each traces one light path per pixel
+            Float radius = FindDefaultNumber<Float>(sceneNode, "radius", 0);
+            integrator = allocator.new_object<VCMIntegrator>(camera, sampler, maxDepth, radius);
+        }
+        else if (integratorType == "mlt")
+        {
+            // spp is the number of mutations per pixel
+            int bootstrap = FindDefaultNumber<int>(sceneNode, "bootstrap", 100000);
+            int chains = FindDefaultNumber<int>(sceneNode, "chains", 1000);
+            Float sigma = FindDefaultNumber<Float>(sceneNode, "sigma", 0.01f);
+            Float largeStep = FindDefaultNumber<Float>(sceneNode, "largestep", 0.3f);
+            integrator = allocator.new_object<MLTIntegrator>(camera, sampler, spp, maxDepth, bootstrap, chains, sigma, largeStep);
+        }
+
+        else if (integratorType == "ao" || integratorType == "albedo" || integratorType == "normal" ||
+                 integratorType == "directonly" || integratorType == "onebounce")
+        {
+            PreviewMode mode = integratorType == "ao" ? PreviewMode::AmbientOcclusion :
+                               integratorType == "albedo" ? PreviewMode::Albedo :
+                               integratorType == "normal" ? PreviewMode::Normal :
+                               integratorType == "directonly" ? PreviewMode::Direct : PreviewMode::OneBounce;
+            Float aoDistance = FindDefaultNumber<Float>(sceneNode, "aodistance", 0);
+            integrator = allocator.new_object<PreviewIntegrator>(camera, sampler, mode, aoDistance);
+        }
+
+        if (integrator == nullptr)
+        {
+            std::cout << "ERROR::Unsupported integrator [ " << integratorType << " ]\n";
+            return false;
+        }
+
+        // every camera sample lands in one pixel with the filter importance sampled
+        if (FindDefaultNumber<int>(sceneNode, "filtersampling", 0) != 0)
+        {
+            if (integrator->SupportsFilterSampling())
+            {
+                film->SetFilterSampling(true);
+            }
+            else
+            {
+                std::cout << "ERROR::Filter sampling is not supported by integrator [ " << integratorType << " ], it is ignored\n";
+            }
+        }
+
+        if (film->Streaming() && integrator->Splats())
+        {
+            std::cout << "ERROR::Integrator [ " << integratorType << " ] splats onto the whole film, it can not render to a streaming film\n";
+            return false;
         }
 
         engine->AddIntegrator(integrator);
+        LoadAssets(sceneNode);
         // material
         std::unordered_map<std::string, Material *> sceneMaterials;
 
@@ -243,17 +530,8 @@ namespace rayflow
             }
         }
         // object
-        struct Model
-        {
-            std::vector<Point3> positions;
-            std::vector<Normal3> normals;
-            std::vector<Point2> texCoords;
-            std::vector<int> fid;
-        };
-
         std::vector<Primitive> scenePrimitives;
         std::vector<Light *> sceneLights;
-        std::unordered_map<std::string, std::vector<Model *>> sceneModels;
 
         for (tinyxml2::XMLElement *shapeNode = sceneNode->FirstChildElement("shape"); shapeNode; shapeNode = shapeNode->NextSiblingElement("shape"))
         {
@@ -284,101 +562,41 @@ namespace rayflow
             {
                 tinyxml2::XMLElement *parmNode = shapeNode->FirstChildElement();
                 std::string filepath = assetPath + parmNode->Attribute("value");
-                // load obj file
-                tinyobj::attrib_t attrib;
-                std::vector<tinyobj::shape_t> shapes;
-                std::vector<tinyobj::material_t> materials;
-                std::string warning;
-                std::string error;
-
-                bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, filepath.c_str());
-
-                if (!warning.empty())
-                {
-                    std::cout << warning << std::endl;
-                }
-
-                if (!error.empty())
-                {
-                    std::cerr << error << std::endl;
-                }
+                // decoded by LoadAssets
+                const ObjAsset &asset = *objAssets[filepath];
 
-                if (!ret)
+                if (!asset.loaded)
                 {
                     return false;
                 }
 
-                for (size_t s = 0; s < shapes.size(); ++s)
-                {
-                    const auto& vData = attrib.vertices;
-                    const auto& nData = attrib.normals;
-                    const auto& texData = attrib.texcoords;
-                    Model *model = allocator.new_object<Model>();
-                    auto &positions = model->positions;
-                    auto &normals = model->normals;
-                    auto &texCoords = model->texCoords;
-                    auto &fid = model->fid;
-
-                    for (size_t i = 0; i < shapes[s].mesh.indices.size(); ++i) {
-                        const auto& idx = shapes[s].mesh.indices[i];
-                        fid.push_back(idx.vertex_index);
-                        fid.push_back(idx.normal_index);
-                        fid.push_back(idx.texcoord_index);
-                    }
-
-                    for (size_t i = 0; i < attrib.vertices.size(); i += 3) {
-                        positions.push_back(Point3(Float(vData[i]), Float(vData[i + 1]), Float(vData[i + 2])));
-                    }
-
-                    for (size_t i = 0; i < attrib.normals.size(); i += 3) {
-                        normals.push_back(Normal3(Float(nData[i]), Float(nData[i + 1]), Float(nData[i + 2])));
-                    }
-
-                    for (size_t i = 0; i < attrib.texcoords.size(); i += 2) {
-                        texCoords.push_back(Point2(Float(texData[i]), Float(texData[i + 1])));
-                    }
-
-                    sceneModels[filepath].push_back(model);
-                }
-
                 parmNode = parmNode->NextSiblingElement();
                 Transform *localToWorld = allocator.new_object<Transform>(ParseTransform(parmNode->FirstChildElement("matrix")->Attribute("value")));
                 Transform *worldToLocal = allocator.new_object<Transform>(Inverse(*localToWorld));
                 parmNode = parmNode->NextSiblingElement();
                 Material *material = sceneMaterials[parmNode->Attribute("id")];
                 parmNode = parmNode->NextSiblingElement();
-                const std::vector<Model*>& models = sceneModels[filepath];
+                // one mesh for the whole file, its vertex pool is transformed once
+                TriangleMeshObject* meshobj = allocator.new_object<TriangleMeshObject>(*localToWorld, asset.positions,
+                                                                                        asset.normals, asset.texCoords,
+                                                                                        asset.fid, allocator);
 
                 if (parmNode)
                 {
                     Spectrum L = ParseSpectrum(parmNode->FirstChildElement("rgb")->Attribute("value"));
 
-                    for (Model* model : models) 
-                    {
-                        TriangleMeshObject* meshobj = allocator.new_object<TriangleMeshObject>(*localToWorld, model->positions, 
-                                                                                                model->normals, model->texCoords, 
-                                                                                                model->fid, allocator);
-
-                        for (int f = 0; f < model->fid.size(); f += 9) {
-                            Shape* tri = allocator.new_object<Triangle>(meshobj, f);
-                            AreaLight* areaLight = allocator.new_object<AreaLight>(worldToLocal, localToWorld, tri, L);
-                            scenePrimitives.push_back(Primitive(tri, material, areaLight));
-                            sceneLights.push_back(areaLight);
-                        }
+                    for (int f = 0; f < asset.fid.size(); f += 9) {
+                        Shape* tri = allocator.new_object<Triangle>(meshobj, f);
+                        AreaLight* areaLight = allocator.new_object<AreaLight>(worldToLocal, localToWorld, tri, L);
+                        scenePrimitives.push_back(Primitive(tri, material, areaLight));
+                        sceneLights.push_back(areaLight);
                     }
                 }
                 else
                 {
-                    for (Model* model : models) 
-                    {
-                        TriangleMeshObject* meshobj = allocator.new_object<TriangleMeshObject>(*localToWorld, model->positions, 
-                                                                                                model->normals, model->texCoords, 
-                                                                                                model->fid, allocator);
-
-                        for (int f = 0; f < model->fid.size(); f += 9) {
-                            Shape* tri = allocator.new_object<Triangle>(meshobj, f);
-                            scenePrimitives.push_back(Primitive(tri, material));
-                        }
+                    for (int f = 0; f < asset.fid.size(); f += 9) {
+                        Shape* tri = allocator.new_object<Triangle>(meshobj, f);
+                        scenePrimitives.push_back(Primitive(tri, material));
                     }
                 }
             }
@@ -414,7 +632,7 @@ namespace rayflow
             }
         }
 
-        engine->mScene_ = allocator.new_object<Scene>(scenePrimitives, sceneLights);
+        engine->mScene_ = allocator.new_object<Scene>(scenePrimitives, sceneLights, lightSamplerType);
 
         return true;
     }
@@ -1,5 +1,6 @@
 #pragma once
 #include <RayFlow/Integrators/bdpt.h>
+#include <RayFlow/Render/samplers.h>
 
 namespace rayflow {
 
@@ -31,10 +32,69 @@ void BDPTIntegrator::Render(const Scene& scene) {
             Path cameraPath(mMaxDepth_ + 2);
             Path lightPath(mMaxDepth_ + 2);
             
+            // light subpaths shared by the pixels of the tile, the pool is refilled once as many camera
+            // subpaths as it holds have used it, so light tracing keeps one light subpath per sample
+            int pathStride = mMaxDepth_ + 2;
+            int poolCapacity = mLightPathConnections_ > 0 ? (x1 - x0) * (y1 - y0) : 0;
+            Path pool(poolCapacity * pathStride);
+            std::vector<int> poolLengths(poolCapacity);
+            int poolSize = 0;
+            int poolUsed = 0;
+            int remainingSamples = (x1 - x0) * (y1 - y0) * sampler->GetSampleCount();
+            RandomSampler poolSampler(1, seed);
+            RandomSampler aovSampler(1, seed);
+            
+            // connections with a visibility test wait until the end of their sample, then all shadow
+            // rays of the sample are traced as one batch
+            std::vector<ShadowRay> shadowRays;
+            std::vector<PendingConnection> pending;
+            Rng rng(seed);
+
+            auto deferConnection = [&](const Spectrum& Lpath, const ShadowRay& shadowRay, const Point2& pFilmHit, bool splat) {
+                Spectrum L = Lpath;
+                Float luminance = L.Luminance();
+
+                if (luminance < mShadowRRThreshold_) {
+                    Float q = std::max<Float>(luminance, 0) / mShadowRRThreshold_;
+
+                    if (rng.UniformFloat() >= q) {
+                        return;
+                    }
+                    L = L / q;
+                }
+
+                shadowRays.push_back(shadowRay);
+                pending.push_back(PendingConnection{ L, pFilmHit, splat });
+            };
+
+            // returns the unoccluded contributions to the film sample, splats go to the film
+            auto resolveConnections = [&]() {
+                Spectrum L(0.f);
+                scene.Occluded(shadowRays.data(), shadowRays.size());
+
+                for (size_t k = 0; k < pending.size(); ++k) {
+                    if (shadowRays[k].occluded) {
+                        continue;
+                    }
+
+                    if (pending[k].splat) {
+                        film->AddSplat(pending[k].pFilm, pending[k].L);
+                    }
+                    else {
+                        L += pending[k].L;
+                    }
+                }
+
+                shadowRays.clear();
+                pending.clear();
+                return L;
+            };
+            
             for (int y = y0; y < y1; ++y) {
                 for (int x = x0; x < x1; ++x) {
                     Point2i pRaster(x, y);
                     size_t sampleCount = sampler->GetSampleCount();
+                    Float differentialScale = CameraRayDifferentialScale(sampleCount);
                     sampler->StartPixel(pRaster);
                     //if (x == 305 && y == 487) {
                     //    std::cout << 1 << std::endl;
@@ -45,30 +105,103 @@ void BDPTIntegrator::Render(const Scene& scene) {
                     for (int i = 0; i < sampleCount; ++i) {
                         Point2 pFilm = Point2(pRaster) + sampler->Get2D();
                         Spectrum L(0.f);
-                        int nCameraPathVertex = ConstructCameraPath(scene, *sampler,  pFilm, cameraPath);
-                        int nLightPathVertex = ConstructLightPath(scene, *sampler, lightPath);
-                        Float weisum = 0;
-                        for (int t = 1; t <= nCameraPathVertex; ++t) {
-                            for (int s = 0; s <= nLightPathVertex; ++s) {
-                                int depth = s + t - 2;
-
-                                if ((s == 1 && t == 1) || depth < 0 || depth > mMaxDepth_) {
-                                    continue;
-                                }
+                        int nCameraPathVertex = ConstructCameraPath(scene, *sampler,  pFilm, cameraPath, -1, differentialScale);
+
+                        if (filmTile->HasAOVs()) {
+                            filmTile->AddAOVSample(pFilm, nCameraPathVertex > 1 ?
+                                FirstHitAOVs(scene, cameraPath[1].si, Distance(cameraPath[0].si.p, cameraPath[1].si.p), aovSampler) : AOVSample());
+                        }
 
-                                Point2f pFilmHit(-1, -1);
-                                Spectrum Lpath = ConnectPath(scene, *sampler, cameraPath, lightPath, t, s, &pFilmHit);
+                        if (mLightPathConnections_ == 0) {
+                            int nLightPathVertex = ConstructLightPath(scene, *sampler, lightPath.data());
+                            for (int t = 1; t <= nCameraPathVertex; ++t) {
+                                for (int s = 0; s <= nLightPathVertex; ++s) {
+                                    int depth = s + t - 2;
+
+                                    if ((s == 1 && t == 1) || depth < 0 || depth > mMaxDepth_) {
+                                        continue;
+                                    }
+
+                                    Point2f pFilmHit(-1, -1);
+                                    ShadowRay shadowRay;
+                                    Spectrum Lpath = ConnectPath(scene, *sampler, cameraPath.data(), lightPath.data(), t, s, &pFilmHit, &shadowRay);
+
+                                    if (Lpath.IsBlack()) {
+                                        continue;
+                                    }
+
+                                    if (s == 0) {
+                                        L += Lpath;
+                                    }
+                                    else {
+                                        deferConnection(Lpath, shadowRay, pFilmHit, t == 1);
+                                    }
+                                }
 
-                                if (t != 1) {
-                                    L += Lpath;
+                            }
+                        }
+                        else {
+                            if (poolUsed == poolSize) {
+                                poolSize = std::min(poolCapacity, remainingSamples);
+                                poolUsed = 0;
+
+                                // the light tracing strategies of a pooled path are splatted once, when it is traced
+                                for (int j = 0; j < poolSize; ++j) {
+                                    const Vertex* pooledPath = &pool[j * pathStride];
+                                    poolLengths[j] = ConstructLightPath(scene, poolSampler, &pool[j * pathStride]);
+
+                                    for (int s = 2; s <= poolLengths[j] && s - 1 <= mMaxDepth_; ++s) {
+                                        Point2f pFilmHit(-1, -1);
+                                        ShadowRay shadowRay;
+                                        Spectrum Lpath = ConnectPath(scene, poolSampler, nullptr, pooledPath, 1, s, &pFilmHit, &shadowRay);
+
+                                        if (!Lpath.IsBlack()) {
+                                            deferConnection(Lpath, shadowRay, pFilmHit, true);
+                                        }
+                                    }
                                 }
-                                else {
-                                    film->AddSplat(pFilmHit, Lpath);
+                            }
+                            ++poolUsed;
+                            --remainingSamples;
+
+                            // strategies without light subpath vertices are evaluated once, the others are
+                            // averaged over the connected subpaths
+                            for (int c = 0; c < mLightPathConnections_; ++c) {
+                                int j = std::min(int(sampler->Get1D() * poolSize), poolSize - 1);
+                                const Vertex* pooledPath = &pool[j * pathStride];
+                                int sMin = c == 0 ? 0 : 2;
+                                int sMax = std::max(poolLengths[j], c == 0 ? 1 : 0);
+
+                                for (int t = 2; t <= nCameraPathVertex; ++t) {
+                                    for (int s = sMin; s <= sMax; ++s) {
+                                        if (s + t - 2 > mMaxDepth_) {
+                                            continue;
+                                        }
+
+                                        ShadowRay shadowRay;
+                                        Spectrum Lpath = ConnectPath(scene, *sampler, cameraPath.data(), pooledPath, t, s, nullptr, &shadowRay);
+
+                                        if (Lpath.IsBlack()) {
+                                            continue;
+                                        }
+
+                                        if (s > 1) {
+                                            Lpath = Lpath / mLightPathConnections_;
+                                        }
+
+                                        if (s == 0) {
+                                            L += Lpath;
+                                        }
+                                        else {
+                                            deferConnection(Lpath, shadowRay, Point2(), false);
+                                        }
+                                    }
                                 }
                             }
-
                         }
 
+                        L += resolveConnections();
+
                         if (L.HasNaN()) {
                             L = Spectrum(0.f);
                         }
@@ -91,15 +224,18 @@ void BDPTIntegrator::Render(const Scene& scene) {
     film->Write(1.0f / mSampler_->GetSampleCount());
 }
 
-int BDPTIntegrator::ConstructCameraPath(const Scene& scene, Sampler& sampler, const Point2& pFilm, Path& path) const {
+int BDPTIntegrator::ConstructCameraPath(const Scene& scene, Sampler& sampler, const Point2& pFilm, Path& path, int maxDepth,
+                                        Float differentialScale) const {
     auto cameraWeSample = mCamera_->SampleWe(pFilm, sampler.Get2D());
     path[0] = Vertex(mCamera_, *cameraWeSample);
     Spectrum alpha = Spectrum(1.0f);
     Float pdfDir = cameraWeSample->crs.pdfDir;
-    return RandomWalk(scene, sampler, cameraWeSample->crs.ray, alpha, pdfDir, path, TransportMode::Radiance) + 1;
+    Ray ray = cameraWeSample->crs.ray;
+    ray.ScaleDifferentials(differentialScale);
+    return RandomWalk(scene, sampler, ray, alpha, pdfDir, path.data(), TransportMode::Radiance, maxDepth) + 1;
 }
 
-int BDPTIntegrator::ConstructLightPath(const Scene& scene, Sampler& sampler, Path& path) const {
+int BDPTIntegrator::ConstructLightPath(const Scene& scene, Sampler& sampler, Vertex* path, int maxDepth) const {
     auto lightSample = scene.SampleLight(Point3(), sampler.Get1D());
     auto emitSample = lightSample.light->SampleLe(sampler.Get2D(), sampler.Get2D());
     if (!emitSample) {
@@ -112,16 +248,21 @@ int BDPTIntegrator::ConstructLightPath(const Scene& scene, Sampler& sampler, Pat
     Spectrum alpha = emitSample->L * AbsDot(emitSample->pLight.ng, ray.d) / 
             (lightSample.pdf * pdfPos * pdfDir);
     
-    return RandomWalk(scene, sampler, ray, alpha, pdfDir, path, TransportMode::Importance) + 1;
+    return RandomWalk(scene, sampler, ray, alpha, pdfDir, path, TransportMode::Importance, maxDepth) + 1;
 }
 
-int BDPTIntegrator::RandomWalk(const Scene& scene, Sampler& sampler, Ray ray, Spectrum alpha, Float pdfDir, Path& path, TransportMode mode) const {
+int BDPTIntegrator::RandomWalk(const Scene& scene, Sampler& sampler, Ray ray, Spectrum alpha, Float pdfDir, Vertex* path, TransportMode mode,
+                               int maxDepth) const {
+    if (maxDepth < 0) {
+        maxDepth = mMaxDepth_;
+    }
+
     int bounce = 0;
     int count = 1;
     Float pdfFwd = pdfDir;
     Float pdfBwd = 0;
 
-    for (; bounce < mMaxDepth_;) {
+    for (; bounce < maxDepth;) {
         if (alpha.IsBlack()) {
             break;
         }
@@ -158,25 +299,40 @@ int BDPTIntegrator::RandomWalk(const Scene& scene, Sampler& sampler, Ray ray, Sp
         }
         
         prev.pdfBwd = current.ConvertPdf(prev, pdfBwd);
+
+        // the reverse pdf of prev is final, extend the running MIS sum through it
+        if (count >= 3) {
+            // the other subpath has more than one vertex wherever this sum is used
+            const Vertex& prevPrev = path[count - 3];
+            Float connectible = (!prev.delta && !prevPrev.delta) ? StrategyCount(count - 2, count - 2) : 0;
+            prev.misSum = PdfRatio(prev.pdfBwd, prev.pdfFwd) * (connectible + prevPrev.misSum);
+        }
+        else if (prev.type == Vertex::VertexType::Light) {
+            prev.misSum = PdfRatio(prev.pdfBwd, prev.pdfFwd) * (prev.IsDeltaLight() ? 0 : 1);
+        }
         ray = si->isect.SpawnRay(bsdfSample->wi);
     }
 
     return bounce;
 }
 
-Spectrum BDPTIntegrator::ConnectPath(const Scene& scene, Sampler& sampler, Path& cameraPath, Path& lightPath, int t, int s, Point2* pFilm) const {
+Spectrum BDPTIntegrator::ConnectPath(const Scene& scene, Sampler& sampler, const Vertex* cameraPath, const Vertex* lightPath, int t, int s, Point2* pFilm,
+                                     ShadowRay* shadowRay) const {
     Spectrum L(0.f);
     Vertex vSample;
 
+    auto visible = [&](const SurfaceIntersection& p0, const SurfaceIntersection& p1) {
+        return shadowRay ? ConnectionShadowRay(p0, p1, shadowRay) : Visable(scene, p0, p1);
+    };
+
     if (t == 1) {
-        Vertex& camVert = cameraPath[0];
-        Vertex& ligVert = lightPath[s - 1];
+        // the camera vertex is sampled anew, cameraPath is not read
+        const Vertex& ligVert = lightPath[s - 1];
         if (ligVert.IsConnectible()) {
-            const auto& camera = *camVert.camera;
-            auto cameraWiSample = camera.SampleWi(ligVert.si, sampler.Get2D());
+            auto cameraWiSample = mCamera_->SampleWi(ligVert.si, sampler.Get2D());
 
             if (cameraWiSample && cameraWiSample->pdfDir > 0) {
-                vSample = Vertex(camVert.camera, *cameraWiSample);
+                vSample = Vertex(mCamera_, *cameraWiSample);
                 const Spectrum& importance = cameraWiSample->W;
                 const Normal3& lenNormal = cameraWiSample->pLen.ng;
                 const Vector3& wi = cameraWiSample->wi;
@@ -187,7 +343,7 @@ Spectrum BDPTIntegrator::ConnectPath(const Scene& scene, Sampler& sampler, Path&
                 L = ligVert.alpha * ligVert.f(vSample, TransportMode::Importance) *
                     (importance * AbsDot(lenNormal, -wi) * AbsDot(ligVert.ns(), wi) * invDist2) / pdfPos;
 
-                if (!L.IsBlack() && !Visable(scene, ligVert.si, vSample.si)) {
+                if (!L.IsBlack() && !visible(ligVert.si, vSample.si)) {
                     L = Spectrum(0.f);
                 }
             }
@@ -220,7 +376,7 @@ Spectrum BDPTIntegrator::ConnectPath(const Scene& scene, Sampler& sampler, Path&
                 L = camVert.alpha * camVert.f(vSample, TransportMode::Radiance) * 
                     (Le * invDist2 * AbsDot(wi, lightNormal) * AbsDot(wi, camVert.ns())) / (pdfSampleLight * pdfPos);
 
-                if (!L.IsBlack() && !Visable(scene, camVert.si, vSample.si)) {
+                if (!L.IsBlack() && !visible(camVert.si, vSample.si)) {
                     L = Spectrum(0.f);
                 }
             }
@@ -235,7 +391,7 @@ Spectrum BDPTIntegrator::ConnectPath(const Scene& scene, Sampler& sampler, Path&
                 ligVert.f(camVert, TransportMode::Importance) * ligVert.alpha;
 
             if (!L.IsBlack()) {
-                L *= G(scene, camVert.si, ligVert.si);
+                L *= visible(camVert.si, ligVert.si) ? GeometryTerm(camVert.si, ligVert.si) : 0;
             }
         }
     }
@@ -248,77 +404,55 @@ Spectrum BDPTIntegrator::ConnectPath(const Scene& scene, Sampler& sampler, Path&
     return weight * L;
 }
 
-Float BDPTIntegrator::MIS(const Scene& scene, Path& cameraPath, Path& lightPath, Vertex& vSample, int s, int t) const {
+Float BDPTIntegrator::MIS(const Scene& scene, const Vertex* cameraPath, const Vertex* lightPath, const Vertex& vSample, int s, int t) const {
     if (s + t == 2) {
         return 1;
     }
 
-    Vertex* camVert = t > 0 ? &cameraPath[t - 1] : nullptr;
-    Vertex* camVertPrev = t > 1 ? &cameraPath[t - 2] : nullptr;
-    Vertex* ligVert = s > 0 ? &lightPath[s - 1] : nullptr;
-    Vertex* ligVertPrev = s > 1 ? &lightPath[s - 2] : nullptr;
-
-    BackUp<Vertex> endPointBackUp;
-    if (t == 1) {
-        endPointBackUp = BackUp<Vertex>(camVert, vSample);
-    }
-    else if (s == 1) {
-        endPointBackUp = BackUp<Vertex>(ligVert, vSample);
-    }
-
-    BackUp<Float> camVertBackUp, camVertPrevBackUp;
-    if (camVert) {
-        camVertBackUp = BackUp<Float>(&camVert->pdfBwd,
-            s > 0 ? ligVert->PdfPnext(scene, ligVertPrev, *camVert) :
-                    camVert->PdfPlight(scene, *camVertPrev));
-    }
-    if (camVertPrev) {
-        camVertPrevBackUp = BackUp<Float>(&camVertPrev->pdfBwd,
-            s > 0 ? camVert->PdfPnext(scene, ligVert, *camVertPrev) :
-                    camVert->PdfPLightNext(scene, *camVertPrev));
-    }
-
-    BackUp<Float> ligVertBackUp, ligVertPrevBackUp;
-    if (ligVert) {
-        ligVertBackUp = BackUp<Float>(&ligVert->pdfBwd, camVert->PdfPnext(scene, camVertPrev, *ligVert));
-    }
-    if (ligVertPrev) {
-        ligVertPrevBackUp = BackUp<Float>(&ligVertPrev->pdfBwd, ligVert->PdfPnext(scene, camVert, *ligVertPrev));
-    }
+    // a sampled endpoint stands in for the stored one
+    const Vertex* camVert = t == 1 ? &vSample : &cameraPath[t - 1];
+    const Vertex* camVertPrev = t > 1 ? &cameraPath[t - 2] : nullptr;
+    const Vertex* ligVert = s == 1 ? &vSample : (s > 1 ? &lightPath[s - 1] : nullptr);
+    const Vertex* ligVertPrev = s > 1 ? &lightPath[s - 2] : nullptr;
 
+    // only the reverse pdfs of the two vertices next to the connection differ from the ones
+    // the random walks stored, the rest of each sum comes from the running misSum. Every ratio
+    // is scaled by how often its strategy is evaluated per camera subpath
     Float sumRi = 0;
-    Float ri = 1;
-
-    for (int i = t - 1; i > 0; --i) {
-        Float pdfFwd = cameraPath[i].pdfFwd;
-        Float pdfBwd = cameraPath[i].pdfBwd;
-        Float tmp = 1;
 
-        ri *= (pdfBwd > 0 ? pdfBwd : 1) / 
-             (pdfFwd > 0 ? pdfFwd : 1);
-
-        if (!cameraPath[i].delta && !cameraPath[i - 1].delta) {
-            sumRi += ri;
+    if (t > 1) {
+        Float pdfBwd = s > 0 ? ligVert->PdfPnext(scene, ligVertPrev, *camVert) :
+                               camVert->PdfPlight(scene, *camVertPrev);
+        Float partial = (!camVert->delta && !camVertPrev->delta) ? StrategyCount(s + 1, t - 1) : 0;
+
+        if (t > 2) {
+            Float pdfBwdPrev = s > 0 ? camVert->PdfPnext(scene, ligVert, *camVertPrev) :
+                                       camVert->PdfPLightNext(scene, *camVertPrev);
+            const Vertex& v = cameraPath[t - 3];
+            Float connectible = (!camVertPrev->delta && !v.delta) ? StrategyCount(s + 2, t - 2) : 0;
+            partial += PdfRatio(pdfBwdPrev, camVertPrev->pdfFwd) * (connectible + v.misSum);
         }
-    }
-
-    ri = 1;
 
-    for (int i = s - 1; i >= 0; --i) {
-        Float pdfFwd = lightPath[i].pdfFwd;
-        Float pdfBwd = lightPath[i].pdfBwd;
-
-        ri *= (pdfBwd > 0 ? pdfBwd : 1) / 
-              (pdfFwd > 0 ? pdfFwd : 1);
+        sumRi += PdfRatio(pdfBwd, camVert->pdfFwd) * partial;
+    }
 
-        bool deltaPrev = i > 0 ? lightPath[i - 1].delta :
-                                 lightPath[i].IsDeltaLight();
-        if (!lightPath[i].delta && deltaPrev) {
-            sumRi += ri;
+    if (s > 0) {
+        Float pdfBwd = camVert->PdfPnext(scene, camVertPrev, *ligVert);
+        bool deltaPrev = s > 1 ? ligVertPrev->delta : ligVert->IsDeltaLight();
+        Float partial = (!ligVert->delta && !deltaPrev) ? StrategyCount(s - 1, t + 1) : 0;
+
+        if (s > 1) {
+            Float pdfBwdPrev = ligVert->PdfPnext(scene, camVert, *ligVertPrev);
+            bool deltaPrevPrev = s > 2 ? lightPath[s - 3].delta : ligVertPrev->IsDeltaLight();
+            Float connectible = (!ligVertPrev->delta && !deltaPrevPrev) ? StrategyCount(s - 2, t + 2) : 0;
+            Float rest = s > 2 ? lightPath[s - 3].misSum : 0;
+            partial += PdfRatio(pdfBwdPrev, ligVertPrev->pdfFwd) * (connectible + rest);
         }
+
+        sumRi += PdfRatio(pdfBwd, ligVert->pdfFwd) * partial;
     }
 
-    return 1 / (1 + sumRi);
+    return 1 / (1 + sumRi / StrategyCount(s, t));
 }
 
 }
\ No newline at end of file
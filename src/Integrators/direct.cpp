@@ -1,4 +1,6 @@
 #include <RayFlow/Integrators/direct.h>
+#include <RayFlow/Render/reservoir.h>
+#include <RayFlow/Render/samplers.h>
 
 namespace rayflow {
 
@@ -14,6 +16,12 @@ Spectrum DirectIntegrator::Li(const Ray& ray, const Scene& scene, Sampler& sampl
     rstd::optional<BSDF> bsdf = hitPoint.EvaluateBSDF(TransportMode::Radiance);
     // area light contribution
     L += hitPoint.Le(Intersection(ray.o));
+
+    if (mLightCandidates_ > 0) {
+        LightReservoir reservoir = ResampleLights(scene, hitPoint, *bsdf, sampler, mLightCandidates_);
+        return L + ShadeReservoir(scene, hitPoint, *bsdf, reservoir);
+    }
+
     // direct lighting
     SampledLight sampleLight = scene.SampleLight(hitPoint.p, sampler.Get1D());
     const Light* light = sampleLight.light;
@@ -73,4 +81,123 @@ Spectrum DirectIntegrator::Li(const Ray& ray, const Scene& scene, Sampler& sampl
     return L / lightPdf;
 }   
 
+void DirectIntegrator::RenderTile(const Scene& scene, Sampler& sampler, FilmTile* filmTile,
+                                  const AABB2i& pixelBounds, size_t sampleCount, uint64_t seed) {
+    if (mLightCandidates_ <= 0 || mSpatialNeighbors_ <= 0) {
+        SamplingIntegrator::RenderTile(scene, sampler, filmTile, pixelBounds, sampleCount, seed);
+        return;
+    }
+
+    struct TileSample {
+        Point2 pFilm;
+        Spectrum weight;
+        Spectrum Le;
+        bool hit = false;
+        SurfaceIntersection si;
+        rstd::optional<BSDF> bsdf;
+        Float depth = 0;
+        LightReservoir reservoir;
+    };
+
+    int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int height = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    int pixelCount = width * height;
+
+    // every pixel keeps its own stratified sequence while the tile advances one sample index at a time
+    std::vector<Sampler*> pixelSamplers(pixelCount);
+    for (int i = 0; i < pixelCount; ++i) {
+        pixelSamplers[i] = sampler.Clone((seed << 16) + i);
+        pixelSamplers[i]->StartPixel(Point2i(pixelBounds.pMin.x + i % width, pixelBounds.pMin.y + i / width));
+    }
+
+    std::vector<TileSample> samples(pixelCount);
+    std::vector<LightReservoir> reused(pixelCount);
+    RandomSampler aovSampler(1, seed);
+
+    Float differentialScale = CameraRayDifferentialScale(sampleCount);
+
+    for (size_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex) {
+        // primary hits and candidate reservoirs
+        for (int i = 0; i < pixelCount; ++i) {
+            Sampler& pixelSampler = *pixelSamplers[i];
+            Point2i pRaster(pixelBounds.pMin.x + i % width, pixelBounds.pMin.y + i / width);
+            TileSample& sample = samples[i];
+
+            sample.pFilm = Point2(pRaster) + pixelSampler.Get2D();
+            CameraRaySample raySample = mCamera_->GenerateRay(sample.pFilm, pixelSampler.Get2D());
+            raySample.ray.ScaleDifferentials(differentialScale);
+            sample.weight = raySample.weight;
+            sample.Le = Spectrum(0.f);
+            sample.reservoir = LightReservoir();
+
+            auto foundIntersection = scene.Intersect(raySample.ray);
+            sample.hit = foundIntersection.has_value();
+
+            if (sample.hit) {
+                sample.si = foundIntersection->isect;
+                sample.bsdf = sample.si.EvaluateBSDF(TransportMode::Radiance);
+                sample.depth = Distance(raySample.ray.o, sample.si.p);
+                sample.Le = sample.si.Le(Intersection(raySample.ray.o));
+                sample.reservoir = ResampleLights(scene, sample.si, *sample.bsdf, pixelSampler, mLightCandidates_);
+            }
+
+            if (filmTile->HasAOVs()) {
+                filmTile->AddAOVSample(sample.pFilm, sample.hit ? FirstHitAOVs(scene, sample.si, sample.depth, aovSampler) : AOVSample());
+            }
+        }
+
+        // spatial reuse, neighbors with a different orientation or depth are rejected
+        for (int i = 0; i < pixelCount; ++i) {
+            Sampler& pixelSampler = *pixelSamplers[i];
+            const TileSample& sample = samples[i];
+            reused[i] = sample.reservoir;
+
+            if (!sample.hit) {
+                continue;
+            }
+
+            for (int k = 0; k < mSpatialNeighbors_; ++k) {
+                Point2 u = pixelSampler.Get2D();
+                Float uSelect = pixelSampler.Get1D();
+                int x = Clamp(i % width + int(std::round((2 * u.x - 1) * SpatialRadius)), 0, width - 1);
+                int y = Clamp(i / width + int(std::round((2 * u.y - 1) * SpatialRadius)), 0, height - 1);
+                int j = y * width + x;
+                const TileSample& neighbor = samples[j];
+
+                if (j == i || !neighbor.hit ||
+                    Dot(sample.si.ns, neighbor.si.ns) < 0.906f ||
+                    std::abs(neighbor.depth - sample.depth) > 0.1f * sample.depth) {
+                    continue;
+                }
+
+                MergeReservoir(reused[i], sample.si, *sample.bsdf, neighbor.reservoir, neighbor.si.p, uSelect);
+            }
+        }
+
+        // one shadow ray per pixel
+        for (int i = 0; i < pixelCount; ++i) {
+            const TileSample& sample = samples[i];
+            Spectrum L(0.f);
+
+            if (sample.hit) {
+                L = sample.weight * (sample.Le + ShadeReservoir(scene, sample.si, *sample.bsdf, reused[i]));
+            }
+
+            if (L.HasNaN() || L.HasINF()) {
+                std::cout << "Not-a-number radiance value returned for pixel ("
+                    << pixelBounds.pMin.x + i % width << "," << pixelBounds.pMin.y + i / width
+                    << "), sample" << sampleIndex << ".Setting to black.\n";
+                L = Spectrum(0.f);
+            }
+
+            filmTile->AddSample(sample.pFilm, L);
+            pixelSamplers[i]->Advance();
+        }
+    }
+
+    for (Sampler* pixelSampler : pixelSamplers) {
+        delete pixelSampler;
+    }
+}
+
 }
\ No newline at end of file
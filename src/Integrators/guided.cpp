@@ -0,0 +1,195 @@
+#include <RayFlow/Integrators/guided.h>
+
+#include <chrono>
+
+namespace rayflow {
+
+void GuidedPathTracerIntegrator::Render(const Scene& scene) {
+    Preprocess(scene, *mSampler_);
+
+    mSDTree_ = std::make_unique<SDTree>(scene.Bounds());
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point renderStart = Clock::now();
+    double treeSeconds = 0;
+    double trainingSeconds = 0;
+
+    size_t remaining = mSampler_->GetSampleCount();
+    size_t passSpp = 1;
+    int passIndex = 0;
+
+    // every training pass doubles its sample count, so the distribution it learns is built from
+    // as many paths as all previous passes together
+    while (passSpp * 2 <= remaining) {
+        mTraining_ = true;
+        mGuiding_ = passIndex > 0;
+
+        Clock::time_point passStart = Clock::now();
+        RenderPass(scene, passIndex, passSpp);
+
+        Clock::time_point treeStart = Clock::now();
+        mSDTree_->Refine(SpatialThreshold * std::sqrt(Float(passSpp)));
+        Clock::time_point treeEnd = Clock::now();
+
+        treeSeconds += std::chrono::duration<double>(treeEnd - treeStart).count();
+        trainingSeconds += std::chrono::duration<double>(treeEnd - passStart).count();
+
+        remaining -= passSpp;
+        passSpp *= 2;
+        ++passIndex;
+    }
+
+    mTraining_ = false;
+    mGuiding_ = passIndex > 0;
+    RenderPass(scene, passIndex, remaining);
+
+    double totalSeconds = std::chrono::duration<double>(Clock::now() - renderStart).count();
+    std::cout << "Path guiding: " << passIndex << " training passes, "
+              << mSDTree_->LeafCount() << " spatial leaves\n"
+              << "Training: " << trainingSeconds << "s (tree updates " << treeSeconds << "s), "
+              << "total: " << totalSeconds << "s\n";
+
+    mCamera_->mFilm_->Write();
+}
+
+Spectrum GuidedPathTracerIntegrator::Li(const Ray& r, const Scene& scene, Sampler& sampler) const {
+    Spectrum L(0.f);
+    Spectrum beta(1.f);
+    Ray ray = r;
+    bool specularBounce = false;
+
+    GuidedVertex vertices[MaxGuidedVertices];
+    int nVertices = 0;
+
+    // radiance reaching the camera also arrives along every recorded direction of the path
+    auto addRadiance = [&](const Spectrum& contribution) {
+        L += contribution;
+        for (int i = 0; i < nVertices; ++i) {
+            vertices[i].radiance += contribution;
+        }
+    };
+
+    for (int bounce = 0; bounce < mMaxDepth_; ++bounce) {
+        auto foundIntersection = scene.Intersect(ray);
+
+        if (!foundIntersection) {
+            break;
+        }
+
+        auto& si = foundIntersection->isect;
+
+        if (bounce == 0 || specularBounce) {
+            addRadiance(beta * si.Le(Intersection(ray.o)));
+        }
+
+        Spectrum Ld(0.f);
+        auto lightSample = scene.SampleLight(si.p, sampler.Get1D());
+        auto bsdf = si.EvaluateBSDF();
+        DTreeWrapper* dTree = (mTraining_ || mGuiding_) ? mSDTree_->Lookup(si.p) : nullptr;
+
+        // sample direct lighting
+        auto lightLiSample = lightSample.light->SampleLi(si, sampler.Get2D());
+
+        if (lightLiSample && !lightLiSample->L.IsBlack()) {
+            VisibilityTester vis(si, lightLiSample->pLight);
+
+            if (vis.Visiable(scene)) {
+                Spectrum f = bsdf->f(lightLiSample->wi, si.wo) * AbsDot(si.ns, lightLiSample->wi);
+                Float pdfScattering = bsdf->Pdf(lightLiSample->wi, si.wo);
+                Float pdfLightDir = lightLiSample->pdfDir;
+
+                // direct light is not part of the continuation paths, learn it from the light sample
+                if (mTraining_ && pdfLightDir != 0 && !IsDeltaLight(lightSample.light->type)) {
+                    dTree->Record(lightLiSample->wi, lightLiSample->L.Luminance() / (pdfLightDir * lightSample.pdf), 1);
+                }
+
+                if (!f.IsBlack() && pdfLightDir != 0) {
+                    if (IsDeltaLight(lightSample.light->type)) {
+                        Ld += f * lightLiSample->L / pdfLightDir;
+                    }
+                    else {
+                        Float weight = PowerHeuristic(1, pdfLightDir, 1, pdfScattering);
+                        Ld += lightLiSample->L * f * weight / pdfLightDir;
+                    }
+                }
+            }
+        }
+        // sample bsdf
+        if (!IsDeltaLight(lightSample.light->type)) {
+            auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+
+            if (bsdfSample && !HasSpecularComponent(bsdfSample->type)) {
+                Spectrum f = bsdfSample->f * AbsDot(bsdfSample->wi, si.ns);
+                Float pdfScattering = bsdfSample->pdf;
+
+                if (!f.IsBlack() && pdfScattering != 0) {
+                    Float pdfLightDir = lightSample.light->PdfLi(si, bsdfSample->wi);
+                    Float weight = PowerHeuristic(1, pdfScattering, 1, pdfLightDir);
+
+                    if (pdfLightDir != 0) {
+                        auto hitPoint = scene.Intersect(si.SpawnRay(bsdfSample->wi));
+
+                        if (hitPoint && hitPoint->isect.GetAreaLight() == lightSample.light) {
+                            Spectrum Le = lightSample.light->Le(si);
+                            Ld += Le * f * weight / pdfScattering;
+                        }
+                    }
+                }
+            }
+        }
+
+        // add path contribution
+        addRadiance(beta * Ld / lightSample.pdf);
+
+        // sample next direction, one-sample MIS between the BSDF and the learned distribution.
+        // The materials here have either only specular or only non-specular lobes, so a specular
+        // BSDF sample is kept as is and never mixed with the guiding distribution
+        auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+
+        if (!bsdfSample) {
+            break;
+        }
+
+        specularBounce = HasSpecularComponent(bsdfSample->type);
+        Vector3 wi = bsdfSample->wi;
+        Spectrum f = bsdfSample->f;
+        Float woPdf = bsdfSample->pdf;
+
+        if (mGuiding_ && !specularBounce) {
+            Float alpha = mBSDFSamplingFraction_;
+
+            if (sampler.Get1D() >= alpha) {
+                wi = dTree->Sample(sampler.Get2D());
+                f = bsdf->f(wi, si.wo);
+            }
+
+            woPdf = alpha * bsdf->Pdf(wi, si.wo) + (1 - alpha) * dTree->Pdf(wi);
+        }
+
+        if (f.IsBlack() || woPdf == 0) {
+            break;
+        }
+
+        beta *= f * AbsDot(si.ns, wi) / woPdf;
+
+        if (mTraining_ && !specularBounce && nVertices < MaxGuidedVertices) {
+            vertices[nVertices++] = GuidedVertex{ dTree, wi, beta, Spectrum(0.f), woPdf };
+        }
+
+        ray = si.SpawnRay(wi);
+    }
+
+    // incident radiance along each recorded direction, divided by the pdf it was sampled with
+    for (int i = 0; i < nVertices; ++i) {
+        const GuidedVertex& vertex = vertices[i];
+        Float throughput = vertex.throughput.Luminance();
+
+        if (throughput > 0) {
+            vertex.dTree->Record(vertex.wi, vertex.radiance.Luminance() / throughput / vertex.woPdf, 1);
+        }
+    }
+
+    return L;
+}
+
+}
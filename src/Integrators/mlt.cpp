@@ -0,0 +1,223 @@
+#include <RayFlow/Integrators/mlt.h>
+#include <RayFlow/Render/light_sampler.h>
+
+namespace rayflow {
+
+Sampler* MLTSampler::Clone(uint64_t seed) {
+    MLTSampler* sampler = new MLTSampler(*this);
+    sampler->rng.Reset(seed);
+    return sampler;
+}
+
+Float MLTSampler::Get1D() {
+    int index = mStreamIndex_ + mStreamCount_ * mSampleIndex_++;
+    EnsureReady(index);
+    return mSamples_[index].value;
+}
+
+Point2 MLTSampler::Get2D() {
+    Float u0 = Get1D();
+    Float u1 = Get1D();
+    return Point2(u0, u1);
+}
+
+void MLTSampler::StartIteration() {
+    ++mCurrentIteration_;
+    mLargeStep_ = rng.UniformFloat() < mLargeStepProbability_;
+}
+
+void MLTSampler::Accept() {
+    if (mLargeStep_) {
+        mLastLargeStepIteration_ = mCurrentIteration_;
+    }
+}
+
+void MLTSampler::Reject() {
+    for (auto& sample : mSamples_) {
+        if (sample.lastModificationIteration == mCurrentIteration_) {
+            sample.Restore();
+        }
+    }
+    --mCurrentIteration_;
+}
+
+void MLTSampler::EnsureReady(int index) {
+    if (index >= int(mSamples_.size())) {
+        mSamples_.resize(index + 1);
+    }
+    PrimarySample& sample = mSamples_[index];
+
+    // a large step replaced every sample, including the ones it did not read
+    if (sample.lastModificationIteration < mLastLargeStepIteration_) {
+        sample.value = rng.UniformFloat();
+        sample.lastModificationIteration = mLastLargeStepIteration_;
+    }
+
+    sample.Backup();
+
+    if (mLargeStep_) {
+        sample.value = rng.UniformFloat();
+    }
+    else {
+        // the small steps missed since the last change add up to one gaussian of larger variance
+        int64_t smallSteps = mCurrentIteration_ - sample.lastModificationIteration;
+        Float normalSample = Sqrt2 * ErfInv(2 * rng.UniformFloat() - 1);
+        Float effectiveSigma = mSigma_ * ::sqrt(Float(smallSteps));
+        sample.value += normalSample * effectiveSigma;
+        sample.value = std::min<Float>(sample.value - ::floor(sample.value), OneMinusEpsilon);
+    }
+
+    sample.lastModificationIteration = mCurrentIteration_;
+}
+
+void MLTIntegrator::Render(const Scene& scene) {
+    Preprocess(scene, *mSampler_);
+
+    Film* film = mCamera_->mFilm_;
+    AABB2i sampledBounds = mCamera_->mSampleBounds_;
+    int depthCount = mMaxDepth_ + 1;
+    int pathStride = mMaxDepth_ + 2;
+
+    // bootstrap, the mean luminance of independent paths normalizes the chains and picks their start states
+    int bootstrapCount = mBootstrapSamples_ * depthCount;
+    rstd::vector<Float> bootstrapWeights(bootstrapCount);
+    int chunkSize = 256;
+    int chunkCount = (mBootstrapSamples_ + chunkSize - 1) / chunkSize;
+
+    Scheduler::Parallel1D(chunkCount, 1,
+        [&](int chunkBegin, int chunkEnd) {
+            std::vector<Vertex> cameraPath(pathStride);
+            std::vector<Vertex> lightPath(pathStride);
+
+            for (int c = chunkBegin; c < chunkEnd; ++c) {
+                int end = std::min((c + 1) * chunkSize, mBootstrapSamples_);
+
+                for (int i = c * chunkSize; i < end; ++i) {
+                    for (int depth = 0; depth <= mMaxDepth_; ++depth) {
+                        ResetGMalloc();
+
+                        int seed = i * depthCount + depth;
+                        MLTSampler sampler(seed, mSigma_, mLargeStepProbability_, StreamCount);
+                        Point2 pRaster;
+                        bootstrapWeights[seed] = L(scene, sampler, depth, &pRaster, cameraPath, lightPath).Luminance();
+                    }
+                }
+            }
+        }
+    );
+
+    Float weightSum = 0;
+    for (int i = 0; i < bootstrapCount; ++i) {
+        if (!(bootstrapWeights[i] > 0) || std::isinf(bootstrapWeights[i])) {
+            bootstrapWeights[i] = 0;
+        }
+        weightSum += bootstrapWeights[i];
+    }
+
+    if (weightSum == 0) {
+        std::cout << "MLT: no bootstrap path carries light" << std::endl;
+        film->Write();
+        return;
+    }
+
+    AliasTable bootstrap(bootstrapWeights);
+    Float b = weightSum / mBootstrapSamples_;
+
+    int64_t totalMutations = int64_t(mMutationsPerPixel_) * sampledBounds.Area();
+
+    Scheduler::Parallel1D(mChainCount_, 1,
+        [&](int chainBegin, int chainEnd) {
+            std::vector<Vertex> cameraPath(pathStride);
+            std::vector<Vertex> lightPath(pathStride);
+
+            for (int chain = chainBegin; chain < chainEnd; ++chain) {
+                int64_t mutationBegin = totalMutations * chain / mChainCount_;
+                int64_t mutationEnd = totalMutations * (chain + 1) / mChainCount_;
+                Rng rng(chain);
+
+                // replaying the seed of a bootstrap path reproduces it as the start state
+                int seed = bootstrap.Sample(rng.UniformFloat());
+                int depth = seed % depthCount;
+                MLTSampler sampler(seed, mSigma_, mLargeStepProbability_, StreamCount);
+
+                ResetGMalloc();
+                Point2 pCurrent;
+                Spectrum LCurrent = L(scene, sampler, depth, &pCurrent, cameraPath, lightPath);
+
+                for (int64_t j = mutationBegin; j < mutationEnd; ++j) {
+                    ResetGMalloc();
+                    sampler.StartIteration();
+
+                    Point2 pProposed;
+                    Spectrum LProposed = L(scene, sampler, depth, &pProposed, cameraPath, lightPath);
+                    Float luminanceProposed = LProposed.Luminance();
+                    Float luminanceCurrent = LCurrent.Luminance();
+
+                    if (!(luminanceProposed > 0) || std::isinf(luminanceProposed)) {
+                        luminanceProposed = 0;
+                    }
+                    Float accept = std::min<Float>(1, luminanceProposed / luminanceCurrent);
+
+                    // both states are recorded weighted by their acceptance, the expected value of the chain
+                    if (accept > 0) {
+                        film->AddSplat(pProposed, LProposed * accept / luminanceProposed);
+                    }
+                    film->AddSplat(pCurrent, LCurrent * (1 - accept) / luminanceCurrent);
+
+                    if (rng.UniformFloat() < accept) {
+                        pCurrent = pProposed;
+                        LCurrent = LProposed;
+                        sampler.Accept();
+                    }
+                    else {
+                        sampler.Reject();
+                    }
+                }
+            }
+        }
+    );
+
+    film->Write(b / mMutationsPerPixel_);
+}
+
+Spectrum MLTIntegrator::L(const Scene& scene, MLTSampler& sampler, int depth, Point2* pRaster,
+                          std::vector<Vertex>& cameraPath, std::vector<Vertex>& lightPath) const {
+    sampler.StartStream(CameraStreamIndex);
+
+    // the strategy is part of the state, every depth has depth + 2 of them
+    int s, t, strategyCount;
+    if (depth == 0) {
+        strategyCount = 1;
+        s = 0;
+        t = 2;
+    }
+    else {
+        strategyCount = depth + 2;
+        s = std::min<int>(sampler.Get1D() * strategyCount, strategyCount - 1);
+        t = strategyCount - s;
+    }
+
+    AABB2i sampledBounds = mCamera_->mSampleBounds_;
+    Point2 u = sampler.Get2D();
+    Point2 pFilm(sampledBounds.pMin.x + u.x * (sampledBounds.pMax.x - sampledBounds.pMin.x),
+                 sampledBounds.pMin.y + u.y * (sampledBounds.pMax.y - sampledBounds.pMin.y));
+    *pRaster = pFilm;
+
+    if (mBDPT_.ConstructCameraPath(scene, sampler, pFilm, cameraPath, t - 1,
+                                   CameraRayDifferentialScale(mMutationsPerPixel_)) != t) {
+        return Spectrum(0.f);
+    }
+
+    sampler.StartStream(LightStreamIndex);
+    if (s > 0 && mBDPT_.ConstructLightPath(scene, sampler, lightPath.data(), s - 1) != s) {
+        return Spectrum(0.f);
+    }
+
+    // t == 1 projects the light subpath onto the film and moves pRaster
+    sampler.StartStream(ConnectionStreamIndex);
+    Spectrum L = mBDPT_.ConnectPath(scene, sampler, cameraPath.data(), lightPath.data(), t, s, pRaster);
+
+    return L * strategyCount;
+}
+
+}
@@ -0,0 +1,113 @@
+#include <RayFlow/Integrators/preview.h>
+
+namespace rayflow {
+
+Spectrum PreviewIntegrator::Li(const Ray& ray, const Scene& scene, Sampler& sampler) const {
+    auto foundIntersection = scene.Intersect(ray);
+
+    if (!foundIntersection) {
+        return Spectrum(0.f);
+    }
+
+    const SurfaceIntersection& si = foundIntersection->isect;
+
+    if (mMode_ == PreviewMode::Normal) {
+        Vector3 n = Normalize(Vector3(si.ns));
+        return Spectrum(0.5f * (n.x + 1), 0.5f * (n.y + 1), 0.5f * (n.z + 1));
+    }
+
+    if (mMode_ == PreviewMode::AmbientOcclusion) {
+        return AmbientOcclusion(scene, si, sampler);
+    }
+
+    auto bsdf = si.EvaluateBSDF();
+
+    if (!bsdf) {
+        return mMode_ == PreviewMode::Albedo ? Spectrum(0.f) : si.Le(Intersection(ray.o));
+    }
+
+    if (mMode_ == PreviewMode::Albedo) {
+        // one sample estimate of the directional albedo, f * cos / pdf
+        auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+
+        if (!bsdfSample || bsdfSample->pdf == 0) {
+            return Spectrum(0.f);
+        }
+        return bsdfSample->f * AbsDot(bsdfSample->wi, si.ns) / bsdfSample->pdf;
+    }
+
+    Spectrum L = si.Le(Intersection(ray.o));
+    L += DirectLighting(scene, si, *bsdf, sampler);
+
+    if (mMode_ == PreviewMode::Direct) {
+        return L;
+    }
+
+    auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+
+    if (!bsdfSample || bsdfSample->f.IsBlack() || bsdfSample->pdf == 0) {
+        return L;
+    }
+
+    Spectrum beta = bsdfSample->f * AbsDot(bsdfSample->wi, si.ns) / bsdfSample->pdf;
+    auto bounce = scene.Intersect(si.SpawnRay(bsdfSample->wi));
+
+    if (!bounce) {
+        return L;
+    }
+
+    const SurfaceIntersection& next = bounce->isect;
+
+    // light sampling cannot reach lights seen through a specular bounce
+    if (HasSpecularComponent(bsdfSample->type)) {
+        L += beta * next.Le(si);
+    }
+
+    auto nextBsdf = next.EvaluateBSDF();
+
+    if (nextBsdf) {
+        L += beta * DirectLighting(scene, next, *nextBsdf, sampler);
+    }
+
+    return L;
+}
+
+Spectrum PreviewIntegrator::AmbientOcclusion(const Scene& scene, const SurfaceIntersection& si, Sampler& sampler) const {
+    // cosine weighted directions make the estimate the fraction of unoccluded samples
+    Normal3 n = FaceForward(si.ns, si.wo);
+    Frame frame = Frame::FromZ(n);
+    Vector3 wi = frame.FromLocal(CosineWeightedSampleHemiSphere(sampler.Get2D()));
+    Float tMax = mAODistance_ > 0 ? mAODistance_ : INFINITY;
+
+    return scene.IntersectP(si.SpawnRay(wi), tMax) ? Spectrum(0.f) : Spectrum(1.f);
+}
+
+Spectrum PreviewIntegrator::DirectLighting(const Scene& scene, const SurfaceIntersection& si, const BSDF& bsdf, Sampler& sampler) const {
+    SampledLight sampledLight = scene.SampleLight(si.p, sampler.Get1D());
+
+    if (!sampledLight.light || sampledLight.pdf == 0) {
+        return Spectrum(0.f);
+    }
+
+    auto ls = sampledLight.light->SampleLi(si, sampler.Get2D());
+
+    if (!ls || ls->pdfDir == 0 || ls->L.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    Spectrum f = bsdf.f(ls->wi, si.wo) * AbsDot(ls->wi, si.ns);
+
+    if (f.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    VisibilityTester vis(si, ls->pLight);
+
+    if (!vis.Visiable(scene)) {
+        return Spectrum(0.f);
+    }
+
+    return f * ls->L / (ls->pdfDir * sampledLight.pdf);
+}
+
+}
@@ -1,12 +1,36 @@
 #include <RayFlow/Integrators/pt.h>
+#include <RayFlow/Render/reservoir.h>
 
 namespace rayflow {
 
+void PathTracerIntegrator::Preprocess(const Scene& scene, Sampler&) {
+    if (mCacheMinSamples_ <= 0 || mRadianceCache_) {
+        return;
+    }
+
+    Float cellSize = mCacheCellSize_;
+    if (cellSize <= 0) {
+        cellSize = Length(scene.Bounds().Diagonal()) / 256;
+    }
+    mRadianceCache_ = std::make_unique<RadianceCache>(cellSize, mCacheMinSamples_);
+}
+
 Spectrum PathTracerIntegrator::Li(const Ray& r, const Scene& scene, Sampler& sampler) const {
     Spectrum L(0.f);
     Spectrum beta(1.f);
     Ray ray = r;
     bool specularBounce = false;
+    int nonSpecularBounces = 0;
+
+    // vertices that looked the cache up in vain, the radiance the path gathers beyond them becomes their sample
+    struct CacheRecord {
+        Point3 p;
+        Normal3 n;
+        Spectrum L;
+        Spectrum beta;
+    };
+    CacheRecord records[MaxCacheRecords];
+    int recordCount = 0;
 
     for (int bounce = 0; bounce < mMaxDepth_; ++bounce) {
         auto foundIntersection = scene.Intersect(ray);
@@ -21,63 +45,102 @@ Spectrum PathTracerIntegrator::Li(const Ray& r, const Scene& scene, Sampler& sam
             L += beta * si.Le(Intersection(ray.o));
         }
 
-        Spectrum Ld(0.f);
-        auto lightSample = scene.SampleLight(si.p, sampler.Get1D());
         auto bsdf = si.EvaluateBSDF();
 
-        // sample direct lighting
-        auto lightLiSample = lightSample.light->SampleLi(si, sampler.Get2D());
+        if (mRadianceCache_ && nonSpecularBounces >= 2 && bsdf->IsDiffuse()) {
+            Spectrum Lcache;
 
-        if (lightLiSample && !lightLiSample->L.IsBlack()) {
-            VisibilityTester vis(si, lightLiSample->pLight);
+            // a few of the paths that could end in a filled cell go on and add a sample to it, so the cell
+            // keeps converging instead of staying at the estimate of its first samples
+            if (mRadianceCache_->Lookup(si.p, si.ns, &Lcache) && sampler.Get1D() >= CacheRefreshProbability) {
+                L += beta * Lcache;
+                break;
+            }
 
-            if (vis.Visiable(scene)) {
-                Spectrum f = bsdf->f(lightLiSample->wi, si.wo) * AbsDot(si.ns, lightLiSample->wi);
-                Float pdfScattering = bsdf->Pdf(lightLiSample->wi, si.wo);
-                Float pdfLightDir = lightLiSample->pdfDir;
+            if (recordCount < MaxCacheRecords) {
+                records[recordCount++] = CacheRecord{ si.p, si.ns, L, beta };
+            }
+        }
 
-                if (!f.IsBlack() && pdfLightDir != 0) {
-                    if (IsDeltaLight(lightSample.light->type)) {
-                        Ld += f * lightLiSample->L / pdfLightDir;
-                    }
-                    else {
-                        Float weight = PowerHeuristic(1, pdfLightDir, 1, pdfScattering);
-                        Ld += lightLiSample->L * f * weight / pdfLightDir;
-                    }
+        if (mLightCandidates_ > 0) {
+            // the light selection pdf is part of the reservoir's contribution weight
+            LightReservoir reservoir = ResampleLights(scene, si, *bsdf, sampler, mLightCandidates_, true);
+            L += beta * ShadeReservoir(scene, si, *bsdf, reservoir);
+
+            // emitters found by BSDF sampling, weighted against the density the light candidates are drawn with
+            auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+
+            if (bsdfSample && !HasSpecularComponent(bsdfSample->type) && !bsdfSample->f.IsBlack() && bsdfSample->pdf != 0) {
+                auto hitPoint = scene.Intersect(si.SpawnRay(bsdfSample->wi));
+                const AreaLight* light = hitPoint ? hitPoint->isect.GetAreaLight() : nullptr;
+
+                if (light) {
+                    Float pdfLightDir = scene.GetLightSampler()->Pdf(si.p, light) * light->PdfLi(si, bsdfSample->wi);
+                    Float weight = PowerHeuristic(1, bsdfSample->pdf, 1, pdfLightDir);
+                    Spectrum f = bsdfSample->f * AbsDot(bsdfSample->wi, si.ns);
+                    L += beta * f * hitPoint->isect.Le(si) * weight / bsdfSample->pdf;
                 }
             }
         }
-        // sample bsdf
-        if (!IsDeltaLight(lightSample.light->type)) {
-            auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+        else {
+            Spectrum Ld(0.f);
+            auto lightSample = scene.SampleLight(si.p, sampler.Get1D());
+
+            // sample direct lighting
+            auto lightLiSample = lightSample.light->SampleLi(si, sampler.Get2D());
+
+            if (lightLiSample && !lightLiSample->L.IsBlack()) {
+                VisibilityTester vis(si, lightLiSample->pLight);
+
+                if (vis.Visiable(scene)) {
+                    Spectrum f = bsdf->f(lightLiSample->wi, si.wo) * AbsDot(si.ns, lightLiSample->wi);
+                    Float pdfScattering = bsdf->Pdf(lightLiSample->wi, si.wo);
+                    Float pdfLightDir = lightLiSample->pdfDir;
 
-            if (!HasSpecularComponent(bsdfSample->type)) {
-                Spectrum f = bsdfSample->f * AbsDot(bsdfSample->wi, si.ns);
-                Float pdfScattering = bsdfSample->pdf;
-                bool sampledSpecular = ((int)bsdfSample->type & (int)BXDFType::SPECULAR) != 0;
-
-                if (!f.IsBlack() && pdfScattering != 0) {
-                    Float weight = 1;
-                    Float pdfLightDir = 0;
-                    if (!sampledSpecular) {
-                        pdfLightDir = lightSample.light->PdfLi(si, bsdfSample->wi);
-                        weight = PowerHeuristic(1, pdfScattering, 1, pdfLightDir);
+                    if (!f.IsBlack() && pdfLightDir != 0) {
+                        if (IsDeltaLight(lightSample.light->type)) {
+                            Ld += f * lightLiSample->L / pdfLightDir;
+                        }
+                        else {
+                            Float weight = PowerHeuristic(1, pdfLightDir, 1, pdfScattering);
+                            Ld += lightLiSample->L * f * weight / pdfLightDir;
+                        }
                     }
+                }
+            }
+            // sample bsdf
+            if (!IsDeltaLight(lightSample.light->type)) {
+                auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
+
+                if (!HasSpecularComponent(bsdfSample->type)) {
+                    Spectrum f = bsdfSample->f * AbsDot(bsdfSample->wi, si.ns);
+                    Float pdfScattering = bsdfSample->pdf;
+                    bool sampledSpecular = ((int)bsdfSample->type & (int)BXDFType::SPECULAR) != 0;
+
+                    if (!f.IsBlack() && pdfScattering != 0) {
+                        Float weight = 1;
+                        Float pdfLightDir = 0;
+                        if (!sampledSpecular) {
+                            pdfLightDir = lightSample.light->PdfLi(si, bsdfSample->wi);
+                            weight = PowerHeuristic(1, pdfScattering, 1, pdfLightDir);
+                        }
 
-                    if (pdfLightDir != 0) {
-                        auto hitPoint = scene.Intersect(si.SpawnRay(bsdfSample->wi));
+                        if (pdfLightDir != 0) {
+                            auto hitPoint = scene.Intersect(si.SpawnRay(bsdfSample->wi));
 
-                        if (hitPoint && hitPoint->isect.GetAreaLight() == lightSample.light) {
-                            Spectrum Le = lightSample.light->Le(si);
-                            Ld += Le * f * weight / pdfScattering;
+                            if (hitPoint && hitPoint->isect.GetAreaLight() == lightSample.light) {
+                                Spectrum Le = lightSample.light->Le(si);
+                                Ld += Le * f * weight / pdfScattering;
+                            }
                         }
                     }
                 }
             }
+
+            // add path contribution
+            L += beta * Ld / lightSample.pdf;
         }
 
-        // add path contribution
-        L += beta * Ld / lightSample.pdf;
         // sample next direction
         auto bsdfSample = bsdf->SampleF(si.wo, &sampler);
         specularBounce = ((int)bsdfSample->type & (int)BXDFType::SPECULAR) != 0;
@@ -87,6 +150,7 @@ Spectrum PathTracerIntegrator::Li(const Ray& r, const Scene& scene, Sampler& sam
         }
 
         beta *= bsdfSample->f * AbsDot(si.ns, bsdfSample->wi) / bsdfSample->pdf;
+        nonSpecularBounces += specularBounce ? 0 : 1;
         /*
         if (bounce > mRRDepth_) {
             Float q = std::max(Float(0.5), 1 - beta.Luminance());
@@ -98,6 +162,16 @@ Spectrum PathTracerIntegrator::Li(const Ray& r, const Scene& scene, Sampler& sam
         ray = si.SpawnRay(bsdfSample->wi);
     }
 
+    for (int i = 0; i < recordCount; ++i) {
+        const CacheRecord& record = records[i];
+        Spectrum Lo(0.f);
+
+        for (int c = 0; c < Spectrum::nSamples; ++c) {
+            Lo[c] = record.beta[c] > 0 ? (L[c] - record.L[c]) / record.beta[c] : 0;
+        }
+        mRadianceCache_->AddSample(record.p, record.n, Lo);
+    }
+
     return L;
 }
 
@@ -0,0 +1,362 @@
+#include <RayFlow/Integrators/sppm.h>
+#include <RayFlow/Render/reservoir.h>
+#include <RayFlow/Render/samplers.h>
+
+namespace rayflow {
+
+void SPPMIntegrator::Render(const Scene& scene) {
+    Preprocess(scene, *mSampler_);
+
+    Film* film = mCamera_->mFilm_;
+    Point2i resolution = film->resolution;
+    int pixelCount = resolution.x * resolution.y;
+
+    Float initialRadius = mInitialRadius_;
+    if (initialRadius <= 0) {
+        // a few pixel footprints of an object spanning the whole image
+        initialRadius = 4 * Length(scene.Bounds().Diagonal()) / std::max(resolution.x, resolution.y);
+    }
+
+    std::vector<SPPMPixel> pixels(pixelCount);
+    for (SPPMPixel& pixel : pixels) {
+        pixel.radius = initialRadius;
+    }
+
+    VisiblePointGrid grid;
+    for (int iteration = 0; iteration < mIterations_; ++iteration) {
+        GenerateVisiblePoints(scene, pixels, iteration);
+        BuildGrid(pixels, grid);
+
+        if (!grid.nodes.empty()) {
+            TracePhotons(scene, pixels, grid, iteration);
+        }
+
+        UpdatePixels(pixels);
+    }
+
+    // every pixel holds a finished estimate, they reach the film as splats
+    Float photonCount = Float(mIterations_) * mPhotonsPerIteration_;
+    for (int y = 0; y < resolution.y; ++y) {
+        for (int x = 0; x < resolution.x; ++x) {
+            const SPPMPixel& pixel = pixels[y * resolution.x + x];
+            Spectrum L = pixel.Ld / mIterations_;
+
+            if (photonCount > 0 && pixel.radius > 0) {
+                L += pixel.tau / (photonCount * Pi * pixel.radius * pixel.radius);
+            }
+
+            if (L.HasNaN() || L.HasINF()) {
+                L = Spectrum(0.f);
+            }
+
+            film->AddSplat(Point2(x + 0.5f, y + 0.5f), L);
+        }
+    }
+
+    film->Write(1.0f);
+}
+
+void SPPMIntegrator::GenerateVisiblePoints(const Scene& scene, std::vector<SPPMPixel>& pixels, int iteration) const {
+    Point2i resolution = mCamera_->mFilm_->resolution;
+    int filmTileWidth = 16;
+
+    int tileXCount = ((resolution.x + filmTileWidth - 1) / filmTileWidth);
+    int tileYCount = ((resolution.y + filmTileWidth - 1) / filmTileWidth);
+    Point2i tileCount(tileXCount, tileYCount);
+
+    Scheduler::Parallel2D(tileCount,
+        [&](Point2i tile) {
+            ResetGMalloc();
+
+            int seed = (iteration * tileCount.y + tile.y) * tileCount.x + tile.x;
+            Sampler* sampler = mSampler_->ClonePass(seed, iteration);
+
+            int x0 = tile.x * filmTileWidth;
+            int x1 = std::min<int>(x0 + filmTileWidth, resolution.x);
+            int y0 = tile.y * filmTileWidth;
+            int y1 = std::min<int>(y0 + filmTileWidth, resolution.y);
+
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    Point2i pRaster(x, y);
+                    SPPMPixel& pixel = pixels[y * resolution.x + x];
+                    pixel.vp.valid = false;
+                    sampler->StartPixel(pRaster);
+
+                    Point2 pFilm = Point2(pRaster) + sampler->Get2D();
+                    CameraRaySample raySample = mCamera_->GenerateRay(pFilm, sampler->Get2D());
+                    Ray ray = raySample.ray;
+                    ray.ScaleDifferentials(CameraRayDifferentialScale(mIterations_));
+                    Spectrum beta = raySample.weight;
+                    bool specularBounce = false;
+
+                    // follow specular bounces up to the first diffuse or glossy vertex
+                    for (int depth = 0; depth < mMaxDepth_; ++depth) {
+                        auto foundIntersection = scene.Intersect(ray);
+
+                        if (!foundIntersection) {
+                            break;
+                        }
+
+                        const SurfaceIntersection& si = foundIntersection->isect;
+
+                        if (depth == 0 || specularBounce) {
+                            pixel.Ld += beta * si.Le(Intersection(ray.o));
+                        }
+
+                        auto bsdf = si.EvaluateBSDF();
+                        auto bsdfSample = bsdf->SampleF(si.wo, sampler);
+
+                        if (!bsdfSample) {
+                            break;
+                        }
+
+                        if (!HasSpecularComponent(bsdfSample->type)) {
+                            // direct light from a single light sample, indirect light from the photons
+                            LightReservoir reservoir = ResampleLights(scene, si, *bsdf, *sampler, 1);
+                            pixel.Ld += beta * ShadeReservoir(scene, si, *bsdf, reservoir);
+
+                            pixel.vp.si = si;
+                            pixel.vp.beta = beta;
+                            pixel.vp.valid = true;
+                            break;
+                        }
+
+                        if (bsdfSample->f.IsBlack() || bsdfSample->pdf == 0) {
+                            break;
+                        }
+
+                        beta *= bsdfSample->f * AbsDot(bsdfSample->wi, si.ns) / bsdfSample->pdf;
+                        specularBounce = true;
+                        ray = si.SpawnRay(bsdfSample->wi);
+                    }
+                }
+            }
+
+            delete sampler;
+        }
+    );
+}
+
+bool SPPMIntegrator::VisiblePointGrid::ToGrid(const Point3& p, Point3i* pi) const {
+    bool inBounds = true;
+    Vector3 diag = bounds.Diagonal();
+
+    for (int i = 0; i < 3; ++i) {
+        Float offset = diag[i] > 0 ? (p[i] - bounds.pMin[i]) / diag[i] : 0;
+        int cell = int(resolution[i] * offset);
+        inBounds &= (cell >= 0 && cell < resolution[i]);
+        (*pi)[i] = Clamp(cell, 0, resolution[i] - 1);
+    }
+
+    return inBounds;
+}
+
+int SPPMIntegrator::VisiblePointGrid::Hash(const Point3i& pi) const {
+    uint32_t h = (uint32_t(pi.x) * 73856093u) ^ (uint32_t(pi.y) * 19349663u) ^ (uint32_t(pi.z) * 83492791u);
+    return h % heads.size();
+}
+
+void SPPMIntegrator::BuildGrid(std::vector<SPPMPixel>& pixels, VisiblePointGrid& grid) const {
+    int pixelCount = pixels.size();
+    int chunkSize = 4096;
+
+    grid.bounds = AABB3();
+    grid.nodes.clear();
+    Float maxRadius = 0;
+
+    for (const SPPMPixel& pixel : pixels) {
+        if (!pixel.vp.valid) {
+            continue;
+        }
+
+        Vector3 r(pixel.radius, pixel.radius, pixel.radius);
+        grid.bounds = Union(grid.bounds, pixel.vp.si.p - r);
+        grid.bounds = Union(grid.bounds, pixel.vp.si.p + r);
+        maxRadius = std::max(maxRadius, pixel.radius);
+    }
+
+    if (maxRadius == 0) {
+        return;
+    }
+
+    // cells about as wide as the largest search radius
+    Vector3 diag = grid.bounds.Diagonal();
+    Float maxDiag = std::max(diag.x, std::max(diag.y, diag.z));
+    int baseResolution = int(maxDiag / maxRadius);
+    for (int i = 0; i < 3; ++i) {
+        grid.resolution[i] = std::max(int(baseResolution * diag[i] / maxDiag), 1);
+    }
+
+    if (grid.heads.size() != size_t(pixelCount)) {
+        grid.heads = std::vector<std::atomic<int>>(pixelCount);
+    }
+
+    auto cellRange = [&](const SPPMPixel& pixel, Point3i* pMin, Point3i* pMax) {
+        Vector3 r(pixel.radius, pixel.radius, pixel.radius);
+        grid.ToGrid(pixel.vp.si.p - r, pMin);
+        grid.ToGrid(pixel.vp.si.p + r, pMax);
+    };
+
+    // every visible point owns a contiguous range of nodes, one per overlapped cell
+    std::vector<int> offsets(pixelCount + 1, 0);
+    Scheduler::Parallel1D(pixelCount, chunkSize,
+        [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                grid.heads[i] = -1;
+
+                if (!pixels[i].vp.valid) {
+                    continue;
+                }
+
+                Point3i pMin, pMax;
+                cellRange(pixels[i], &pMin, &pMax);
+                offsets[i + 1] = (pMax.x - pMin.x + 1) * (pMax.y - pMin.y + 1) * (pMax.z - pMin.z + 1);
+            }
+        }
+    );
+
+    for (int i = 0; i < pixelCount; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+    grid.nodes.resize(offsets[pixelCount]);
+
+    Scheduler::Parallel1D(pixelCount, chunkSize,
+        [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                if (!pixels[i].vp.valid) {
+                    continue;
+                }
+
+                Point3i pMin, pMax;
+                cellRange(pixels[i], &pMin, &pMax);
+                int node = offsets[i];
+
+                for (int z = pMin.z; z <= pMax.z; ++z) {
+                    for (int y = pMin.y; y <= pMax.y; ++y) {
+                        for (int x = pMin.x; x <= pMax.x; ++x) {
+                            int h = grid.Hash(Point3i(x, y, z));
+                            grid.nodes[node].pixel = i;
+                            grid.nodes[node].next = grid.heads[h].exchange(node);
+                            ++node;
+                        }
+                    }
+                }
+            }
+        }
+    );
+}
+
+void SPPMIntegrator::TracePhotons(const Scene& scene, std::vector<SPPMPixel>& pixels,
+                                  const VisiblePointGrid& grid, int iteration) const {
+    int chunkSize = 1024;
+
+    Scheduler::Parallel1D(mPhotonsPerIteration_, chunkSize,
+        [&](int begin, int end) {
+            ResetGMalloc();
+
+            RandomSampler sampler(1, uint64_t(iteration) * mPhotonsPerIteration_ + begin);
+
+            for (int i = begin; i < end; ++i) {
+                auto lightSample = scene.SampleLight(Point3(), sampler.Get1D());
+                auto emitSample = lightSample.light->SampleLe(sampler.Get2D(), sampler.Get2D());
+
+                if (!emitSample || emitSample->pdfPos == 0 || emitSample->pdfDir == 0 || lightSample.pdf == 0) {
+                    continue;
+                }
+
+                Ray ray = emitSample->ray;
+                Spectrum beta = emitSample->L * AbsDot(emitSample->pLight.ng, ray.d) /
+                        (lightSample.pdf * emitSample->pdfPos * emitSample->pdfDir);
+
+                for (int depth = 0; depth < mMaxDepth_; ++depth) {
+                    if (beta.IsBlack()) {
+                        break;
+                    }
+
+                    auto foundIntersection = scene.Intersect(ray);
+
+                    if (!foundIntersection) {
+                        break;
+                    }
+
+                    const SurfaceIntersection& si = foundIntersection->isect;
+
+                    // direct lighting of the visible points comes from next event estimation
+                    Point3i cell;
+                    if (depth > 0 && grid.ToGrid(si.p, &cell)) {
+                        for (int node = grid.heads[grid.Hash(cell)]; node >= 0; node = grid.nodes[node].next) {
+                            SPPMPixel& pixel = pixels[grid.nodes[node].pixel];
+                            const VisiblePoint& vp = pixel.vp;
+
+                            if (DistanceSquare(vp.si.p, si.p) > pixel.radius * pixel.radius) {
+                                continue;
+                            }
+
+                            auto vpBSDF = vp.si.EvaluateBSDF();
+                            Spectrum phi = beta * vpBSDF->f(si.wo, vp.si.wo);
+
+                            for (int c = 0; c < Spectrum::nSamples; ++c) {
+                                pixel.phi[c].Add(phi[c]);
+                            }
+                            ++pixel.M;
+                        }
+                    }
+
+                    auto bsdf = si.EvaluateBSDF(TransportMode::Importance);
+                    auto bsdfSample = bsdf->SampleF(si.wo, &sampler, TransportMode::Importance);
+
+                    if (!bsdfSample || bsdfSample->f.IsBlack() || bsdfSample->pdf == 0) {
+                        break;
+                    }
+
+                    Spectrum betaNew = beta * bsdfSample->f * AbsDot(bsdfSample->wi, si.ns) / bsdfSample->pdf;
+
+                    // russian roulette keeps the photon power roughly constant
+                    Float luminance = beta.Luminance();
+                    Float q = luminance > 0 ? std::max<Float>(0, 1 - betaNew.Luminance() / luminance) : 0;
+                    if (sampler.Get1D() < q) {
+                        break;
+                    }
+
+                    beta = betaNew / (1 - q);
+                    ray = si.SpawnRay(bsdfSample->wi);
+                }
+            }
+        }
+    );
+}
+
+void SPPMIntegrator::UpdatePixels(std::vector<SPPMPixel>& pixels) const {
+    // fraction of the new photons kept while the radius shrinks
+    const Float gamma = 2.0f / 3.0f;
+
+    Scheduler::Parallel1D(pixels.size(), 4096,
+        [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                SPPMPixel& pixel = pixels[i];
+                int M = pixel.M;
+
+                if (M == 0) {
+                    continue;
+                }
+
+                Float N = pixel.N + gamma * M;
+                Float radius = pixel.radius * std::sqrt(N / (pixel.N + M));
+
+                Spectrum phi;
+                for (int c = 0; c < Spectrum::nSamples; ++c) {
+                    phi[c] = pixel.phi[c];
+                    pixel.phi[c] = 0;
+                }
+
+                pixel.tau = (pixel.tau + pixel.vp.beta * phi) * (radius * radius) / (pixel.radius * pixel.radius);
+                pixel.N = N;
+                pixel.radius = radius;
+                pixel.M = 0;
+            }
+        }
+    );
+}
+
+}
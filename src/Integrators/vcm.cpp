@@ -0,0 +1,535 @@
+#include <RayFlow/Integrators/vcm.h>
+#include <RayFlow/Render/samplers.h>
+
+namespace rayflow {
+
+void VCMIntegrator::Render(const Scene& scene) {
+    Preprocess(scene, *mSampler_);
+
+    Film* film = mCamera_->mFilm_;
+    Point2i resolution = film->resolution;
+    int pathCount = resolution.x * resolution.y;
+    int iterations = mSampler_->GetSampleCount();
+
+    Float initialRadius = mInitialRadius_;
+    if (initialRadius <= 0) {
+        // a couple of pixel footprints of an object spanning the whole image
+        initialRadius = 2 * Length(scene.Bounds().Diagonal()) / std::max(resolution.x, resolution.y);
+    }
+
+    std::vector<LightVertex> vertices;
+    std::vector<int> pathEnds(pathCount);
+    LightVertexGrid grid;
+
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        IterationState it;
+        it.radius = initialRadius / std::pow(Float(iteration + 1), 0.5f * (1 - RadiusAlpha));
+        it.lightPathCount = pathCount;
+        it.pixelCount = pathCount;
+
+        // merging is weighted as a connection whose last vertex is found with probability eta
+        Float etaVCM = Pi * it.radius * it.radius * it.lightPathCount;
+        it.misVMWeight = Mis(etaVCM);
+        it.misVCWeight = Mis(1 / etaVCM);
+        it.vmNormalization = 1 / etaVCM;
+
+        TraceLightPaths(scene, iteration, it, vertices, pathEnds);
+        grid.Build(vertices, it.radius);
+        TraceCameraPaths(scene, iteration, it, vertices, pathEnds, grid);
+    }
+
+    // one light path per pixel and iteration, as in BDPT
+    film->Write(1.0f / iterations);
+}
+
+void VCMIntegrator::TraceLightPaths(const Scene& scene, int iteration, const IterationState& it,
+                                    std::vector<LightVertex>& vertices, std::vector<int>& pathEnds) const {
+    int pathCount = pathEnds.size();
+    int chunkSize = 1024;
+    int chunkCount = (pathCount + chunkSize - 1) / chunkSize;
+
+    // every chunk of paths fills its own array, pathEnds holds chunk local ends until the merge
+    std::vector<std::vector<LightVertex>> chunks(chunkCount);
+    Scheduler::Parallel1D(chunkCount, 1,
+        [&](int chunkBegin, int chunkEnd) {
+            for (int c = chunkBegin; c < chunkEnd; ++c) {
+                ResetGMalloc();
+
+                int begin = c * chunkSize;
+                int end = std::min(begin + chunkSize, pathCount);
+                RandomSampler sampler(1, uint64_t(iteration) * pathCount + begin);
+
+                for (int i = begin; i < end; ++i) {
+                    TraceLightPath(scene, sampler, it, chunks[c]);
+                    pathEnds[i] = chunks[c].size();
+                }
+            }
+        }
+    );
+
+    std::vector<int> chunkOffsets(chunkCount + 1, 0);
+    for (int c = 0; c < chunkCount; ++c) {
+        chunkOffsets[c + 1] = chunkOffsets[c] + chunks[c].size();
+    }
+    vertices.resize(chunkOffsets[chunkCount]);
+
+    Scheduler::Parallel1D(chunkCount, 1,
+        [&](int chunkBegin, int chunkEnd) {
+            for (int c = chunkBegin; c < chunkEnd; ++c) {
+                std::copy(chunks[c].begin(), chunks[c].end(), vertices.begin() + chunkOffsets[c]);
+
+                int end = std::min((c + 1) * chunkSize, pathCount);
+                for (int i = c * chunkSize; i < end; ++i) {
+                    pathEnds[i] += chunkOffsets[c];
+                }
+            }
+        }
+    );
+}
+
+void VCMIntegrator::TraceLightPath(const Scene& scene, Sampler& sampler, const IterationState& it,
+                                   std::vector<LightVertex>& vertices) const {
+    Film* film = mCamera_->mFilm_;
+    int maxPathLength = mMaxDepth_ + 1;
+
+    auto lightSample = scene.SampleLight(Point3(), sampler.Get1D());
+    auto emitSample = lightSample.light->SampleLe(sampler.Get2D(), sampler.Get2D());
+
+    if (!emitSample || emitSample->pdfPos == 0 || emitSample->pdfDir == 0 || lightSample.pdf == 0 ||
+        emitSample->L.IsBlack()) {
+        return;
+    }
+
+    Float directPdf = lightSample.pdf * emitSample->pdfPos;
+    Float emissionPdf = directPdf * emitSample->pdfDir;
+    Float cosLight = AbsDot(emitSample->pLight.ng, emitSample->ray.d);
+
+    SubpathState state;
+    state.throughput = emitSample->L * cosLight / emissionPdf;
+    state.pathLength = 1;
+    state.dVCM = Mis(directPdf / emissionPdf);
+    state.dVC = IsDeltaLight(lightSample.light->type) ? 0 : Mis(cosLight / emissionPdf);
+    state.dVM = state.dVC * it.misVCWeight;
+
+    Ray ray = emitSample->ray;
+
+    for (;; ++state.pathLength) {
+        auto foundIntersection = scene.Intersect(ray);
+
+        if (!foundIntersection) {
+            break;
+        }
+
+        const SurfaceIntersection& si = foundIntersection->isect;
+        Float cosIn = AbsDot(si.ng, si.wo);
+
+        if (cosIn == 0) {
+            break;
+        }
+
+        // the solid angle pdfs of the last segment become area pdfs at the new vertex
+        state.dVCM *= Mis(DistanceSquare(ray.o, si.p));
+        state.dVCM /= Mis(cosIn);
+        state.dVC /= Mis(cosIn);
+        state.dVM /= Mis(cosIn);
+
+        auto bsdf = si.EvaluateBSDF(TransportMode::Importance);
+
+        if (!bsdf->IsSpecular()) {
+            vertices.push_back(LightVertex{ si, state.throughput, state.pathLength, state.dVCM, state.dVC, state.dVM });
+
+            if (state.pathLength + 1 <= maxPathLength) {
+                Point2 pRaster;
+                Spectrum L = ConnectToCamera(scene, sampler, si, *bsdf, state, it, &pRaster);
+
+                if (!L.IsBlack() && !L.HasNaN() && !L.HasINF()) {
+                    film->AddSplat(pRaster, L);
+                }
+            }
+        }
+
+        if (state.pathLength + 2 > maxPathLength) {
+            break;
+        }
+
+        if (!SampleScattering(si, *bsdf, sampler, TransportMode::Importance, it, state, &ray)) {
+            break;
+        }
+    }
+}
+
+void VCMIntegrator::TraceCameraPaths(const Scene& scene, int iteration, const IterationState& it,
+                                     const std::vector<LightVertex>& vertices, const std::vector<int>& pathEnds,
+                                     const LightVertexGrid& grid) const {
+    Film* film = mCamera_->mFilm_;
+    Point2i resolution = film->resolution;
+    AABB2i sampledBounds = mCamera_->mSampleBounds_;
+    int filmTileWidth = 16;
+
+    int tileXCount = ((resolution.x + filmTileWidth - 1) / filmTileWidth);
+    int tileYCount = ((resolution.y + filmTileWidth - 1) / filmTileWidth);
+    Point2i tileCount(tileXCount, tileYCount);
+
+    Scheduler::Parallel2D(tileCount,
+        [&](Point2i tile) {
+            ResetGMalloc();
+
+            int seed = (iteration * tileCount.y + tile.y) * tileCount.x + tile.x;
+            Sampler* sampler = mSampler_->ClonePass(seed, iteration);
+
+            int x0 = sampledBounds.pMin.x + tile.x * filmTileWidth;
+            int x1 = std::min<int>(x0 + filmTileWidth, sampledBounds.pMax.x);
+            int y0 = sampledBounds.pMin.y + tile.y * filmTileWidth;
+            int y1 = std::min<int>(y0 + filmTileWidth, sampledBounds.pMax.y);
+            FilmTile* filmTile = film->GetFilmTile(AABB2i(Point2i(x0, y0), Point2i(x1, y1)));
+
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    Point2i pRaster(x, y);
+                    sampler->StartPixel(pRaster);
+
+                    // the camera path of a pixel connects to the light path traced for the same pixel
+                    int pathIndex = y * resolution.x + x;
+                    int lightPathBegin = pathIndex == 0 ? 0 : pathEnds[pathIndex - 1];
+
+                    Point2 pFilm = Point2(pRaster) + sampler->Get2D();
+                    Spectrum L = CameraPathLi(scene, *sampler, pFilm, it, vertices, lightPathBegin, pathEnds[pathIndex], grid);
+
+                    if (L.HasNaN() || L.HasINF()) {
+                        L = Spectrum(0.f);
+                    }
+
+                    filmTile->AddSample(pFilm, L);
+                }
+            }
+
+            film->MergeFilmTile(filmTile);
+            delete sampler;
+        }
+    );
+}
+
+Spectrum VCMIntegrator::CameraPathLi(const Scene& scene, Sampler& sampler, const Point2& pFilm, const IterationState& it,
+                                     const std::vector<LightVertex>& vertices, int lightPathBegin, int lightPathEnd,
+                                     const LightVertexGrid& grid) const {
+    int maxPathLength = mMaxDepth_ + 1;
+    CameraRaySample raySample = mCamera_->GenerateRay(pFilm, sampler.Get2D());
+    raySample.ray.ScaleDifferentials(CameraRayDifferentialScale(mSampler_->GetSampleCount()));
+
+    if (raySample.pdfDir == 0) {
+        return Spectrum(0.f);
+    }
+
+    // pdfDir is a density over the whole film, the pixel sampling density is pixelCount times larger
+    SubpathState state;
+    state.throughput = raySample.weight;
+    state.pathLength = 1;
+    state.dVCM = Mis(it.lightPathCount / (raySample.pdfDir * it.pixelCount));
+    state.dVC = 0;
+    state.dVM = 0;
+
+    Spectrum L(0.f);
+    Ray ray = raySample.ray;
+
+    for (;; ++state.pathLength) {
+        auto foundIntersection = scene.Intersect(ray);
+
+        if (!foundIntersection) {
+            break;
+        }
+
+        const SurfaceIntersection& si = foundIntersection->isect;
+        Float cosIn = AbsDot(si.ng, si.wo);
+
+        if (cosIn == 0) {
+            break;
+        }
+
+        state.dVCM *= Mis(DistanceSquare(ray.o, si.p));
+        state.dVCM /= Mis(cosIn);
+        state.dVC /= Mis(cosIn);
+        state.dVM /= Mis(cosIn);
+
+        if (si.GetAreaLight()) {
+            L += state.throughput * EmittedRadiance(scene, si, ray.o, state);
+        }
+
+        if (state.pathLength >= maxPathLength) {
+            break;
+        }
+
+        auto bsdf = si.EvaluateBSDF();
+
+        if (!bsdf->IsSpecular()) {
+            L += state.throughput * DirectIllumination(scene, sampler, si, *bsdf, state, it);
+
+            // light vertices are stored in path order, the later ones only make longer paths
+            for (int i = lightPathBegin; i < lightPathEnd; ++i) {
+                const LightVertex& vertex = vertices[i];
+
+                if (vertex.pathLength + 1 + state.pathLength > maxPathLength) {
+                    break;
+                }
+
+                L += state.throughput * vertex.throughput * ConnectVertices(scene, vertex, si, *bsdf, state, it);
+            }
+
+            L += state.throughput * it.vmNormalization * MergeVertices(si, *bsdf, state, it, vertices, grid);
+        }
+
+        if (!SampleScattering(si, *bsdf, sampler, TransportMode::Radiance, it, state, &ray)) {
+            break;
+        }
+    }
+
+    return L;
+}
+
+Spectrum VCMIntegrator::EmittedRadiance(const Scene& scene, const SurfaceIntersection& si, const Point3& pPrev,
+                                        const SubpathState& state) const {
+    Spectrum Le = si.Le(Intersection(pPrev));
+
+    if (Le.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    // an emitter seen directly from the camera has no other technique
+    if (state.pathLength == 1) {
+        return Le;
+    }
+
+    const Light* light = si.GetAreaLight();
+    LightLeSample emitSample(Ray(si.p, si.wo));
+    emitSample.pLight = si;
+    light->PdfLe(emitSample);
+
+    Float directPdf = scene.GetLightSampler()->Pdf(si.p, light) * emitSample.pdfPos;
+    Float emissionPdf = directPdf * emitSample.pdfDir;
+    Float wCamera = Mis(directPdf) * state.dVCM + Mis(emissionPdf) * state.dVC;
+
+    return Le / (1 + wCamera);
+}
+
+Spectrum VCMIntegrator::DirectIllumination(const Scene& scene, Sampler& sampler, const SurfaceIntersection& si,
+                                           const BSDF& bsdf, const SubpathState& state, const IterationState& it) const {
+    auto lightSample = scene.SampleLight(si.p, sampler.Get1D());
+    auto lightLiSample = lightSample.light->SampleLi(si, sampler.Get2D());
+
+    if (!lightLiSample || lightSample.pdf == 0 || lightLiSample->pdfDir == 0 || lightLiSample->L.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    const Intersection& pLight = lightLiSample->pLight;
+    Float dist2 = DistanceSquare(si.p, pLight.p);
+
+    if (dist2 == 0) {
+        return Spectrum(0.f);
+    }
+
+    // the direction of the delta light samples is not normalized
+    Vector3 wi = (pLight.p - si.p) / std::sqrt(dist2);
+    Spectrum f = bsdf.f(wi, si.wo);
+
+    if (f.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    LightLeSample emitSample(Ray(pLight.p, -wi));
+    emitSample.pLight = pLight;
+    lightSample.light->PdfLe(emitSample);
+
+    // light selection and the position pdf cancel in the emission to direct sampling ratio
+    Float lightPdf = lightSample.pdf * lightLiSample->pdfDir;
+    Float wLight = IsDeltaLight(lightSample.light->type) ? 0 : Mis(bsdf.Pdf(wi, si.wo) / lightPdf);
+    Float wCamera = Mis(emitSample.pdfDir * AbsDot(si.ng, wi) / dist2) *
+                    (it.misVMWeight + state.dVCM + state.dVC * Mis(bsdf.Pdf(si.wo, wi)));
+
+    Spectrum L = f * lightLiSample->L * AbsDot(si.ns, wi) / (lightPdf * (wLight + 1 + wCamera));
+
+    if (L.IsBlack() || !VisibilityTester(si, pLight).Visiable(scene)) {
+        return Spectrum(0.f);
+    }
+
+    return L;
+}
+
+Spectrum VCMIntegrator::ConnectToCamera(const Scene& scene, Sampler& sampler, const SurfaceIntersection& si,
+                                        const BSDF& bsdf, const SubpathState& state, const IterationState& it,
+                                        Point2* pRaster) const {
+    auto cameraWiSample = mCamera_->SampleWi(si, sampler.Get2D());
+
+    if (!cameraWiSample || cameraWiSample->pdfPos == 0) {
+        return Spectrum(0.f);
+    }
+
+    const Intersection& pLen = cameraWiSample->pLen;
+    const Vector3& wi = cameraWiSample->wi;
+    Float dist2 = DistanceSquare(pLen.p, si.p);
+    Spectrum f = bsdf.f(-wi, si.wo, TransportMode::Importance);
+
+    if (f.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    Float pdfPos = 0;
+    Float pdfDir = 0;
+    mCamera_->PdfWe(Ray(pLen.p, wi), &pdfPos, &pdfDir);
+
+    // area density of si when it is found by a camera path, per pixel as the light paths are per pixel
+    Float cameraPdf = pdfDir * it.pixelCount * AbsDot(si.ng, wi) / dist2;
+    Float wLight = Mis(cameraPdf / it.lightPathCount) *
+                   (it.misVMWeight + state.dVCM + state.dVC * Mis(bsdf.Pdf(si.wo, -wi)));
+
+    Spectrum L = state.throughput * f * cameraWiSample->W *
+                 (AbsDot(pLen.ng, wi) * AbsDot(si.ns, wi) / (dist2 * cameraWiSample->pdfPos * (wLight + 1)));
+
+    if (L.IsBlack() || !VisibilityTester(si, pLen).Visiable(scene)) {
+        return Spectrum(0.f);
+    }
+
+    *pRaster = cameraWiSample->pRaster;
+    return L;
+}
+
+Spectrum VCMIntegrator::ConnectVertices(const Scene& scene, const LightVertex& vertex, const SurfaceIntersection& si,
+                                        const BSDF& bsdf, const SubpathState& state, const IterationState& it) const {
+    Float dist2 = DistanceSquare(vertex.si.p, si.p);
+
+    if (dist2 == 0) {
+        return Spectrum(0.f);
+    }
+
+    Vector3 w = (vertex.si.p - si.p) / std::sqrt(dist2);
+    Spectrum cameraF = bsdf.f(w, si.wo);
+
+    if (cameraF.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    auto lightBSDF = vertex.si.EvaluateBSDF(TransportMode::Importance);
+    Spectrum lightF = lightBSDF->f(-w, vertex.si.wo, TransportMode::Importance);
+
+    if (lightF.IsBlack()) {
+        return Spectrum(0.f);
+    }
+
+    // area densities of each endpoint when sampled from the other one
+    Float cameraPdf = bsdf.Pdf(w, si.wo) * AbsDot(vertex.si.ng, w) / dist2;
+    Float lightPdf = lightBSDF->Pdf(-w, vertex.si.wo) * AbsDot(si.ng, w) / dist2;
+
+    Float wLight = Mis(cameraPdf) *
+                   (it.misVMWeight + vertex.dVCM + vertex.dVC * Mis(lightBSDF->Pdf(vertex.si.wo, -w)));
+    Float wCamera = Mis(lightPdf) *
+                    (it.misVMWeight + state.dVCM + state.dVC * Mis(bsdf.Pdf(si.wo, w)));
+
+    Spectrum L = cameraF * lightF * (AbsDot(si.ns, w) * AbsDot(vertex.si.ns, w) / (dist2 * (wLight + 1 + wCamera)));
+
+    if (L.IsBlack() || !Visable(scene, si, vertex.si)) {
+        return Spectrum(0.f);
+    }
+
+    return L;
+}
+
+Spectrum VCMIntegrator::MergeVertices(const SurfaceIntersection& si, const BSDF& bsdf, const SubpathState& state,
+                                      const IterationState& it, const std::vector<LightVertex>& vertices,
+                                      const LightVertexGrid& grid) const {
+    int maxPathLength = mMaxDepth_ + 1;
+    Spectrum L(0.f);
+
+    grid.Query(vertices, si.p, it.radius,
+        [&](const LightVertex& vertex) {
+            if (vertex.pathLength + state.pathLength > maxPathLength) {
+                return;
+            }
+
+            // the light vertex is taken to lie at si, it arrived from vertex.si.wo
+            Spectrum f = bsdf.f(vertex.si.wo, si.wo);
+
+            if (f.IsBlack()) {
+                return;
+            }
+
+            Float wLight = vertex.dVCM * it.misVCWeight + vertex.dVM * Mis(bsdf.Pdf(vertex.si.wo, si.wo));
+            Float wCamera = state.dVCM * it.misVCWeight + state.dVM * Mis(bsdf.Pdf(si.wo, vertex.si.wo));
+
+            L += f * vertex.throughput / (wLight + 1 + wCamera);
+        }
+    );
+
+    return L;
+}
+
+bool VCMIntegrator::SampleScattering(const SurfaceIntersection& si, const BSDF& bsdf, Sampler& sampler, TransportMode mode,
+                                     const IterationState& it, SubpathState& state, Ray* ray) const {
+    auto bsdfSample = bsdf.SampleF(si.wo, &sampler, mode);
+
+    if (!bsdfSample || bsdfSample->f.IsBlack() || bsdfSample->pdf == 0) {
+        return false;
+    }
+
+    const Vector3& wi = bsdfSample->wi;
+    Float cosOut = AbsDot(si.ng, wi);
+
+    if (HasSpecularComponent(bsdfSample->type)) {
+        // the forward and reverse pdfs of a specular bounce are equal and cancel
+        state.dVCM = 0;
+        state.dVC *= Mis(cosOut);
+        state.dVM *= Mis(cosOut);
+    }
+    else {
+        Float pdfFwd = bsdfSample->pdf;
+        Float pdfBwd = bsdf.Pdf(si.wo, wi);
+
+        state.dVC = Mis(cosOut / pdfFwd) * (state.dVC * Mis(pdfBwd) + state.dVCM + it.misVMWeight);
+        state.dVM = Mis(cosOut / pdfFwd) * (state.dVM * Mis(pdfBwd) + state.dVCM * it.misVCWeight + 1);
+        state.dVCM = Mis(1 / pdfFwd);
+    }
+
+    state.throughput *= bsdfSample->f * AbsDot(si.ns, wi) / bsdfSample->pdf;
+    state.throughput *= CorrectNonsymmetryCauseByShadingNormal(si, wi, mode);
+
+    *ray = si.SpawnRay(wi);
+    return true;
+}
+
+Point3i VCMIntegrator::LightVertexGrid::Cell(const Point3& p) const {
+    Vector3 offset = (p - bounds.pMin) / cellSize;
+    return Point3i(int(std::floor(offset.x)), int(std::floor(offset.y)), int(std::floor(offset.z)));
+}
+
+int VCMIntegrator::LightVertexGrid::Hash(const Point3i& pi) const {
+    uint32_t h = (uint32_t(pi.x) * 73856093u) ^ (uint32_t(pi.y) * 19349663u) ^ (uint32_t(pi.z) * 83492791u);
+    return h % cellEnds.size();
+}
+
+void VCMIntegrator::LightVertexGrid::Build(const std::vector<LightVertex>& vertices, Float radius) {
+    int vertexCount = vertices.size();
+
+    bounds = AABB3();
+    for (const LightVertex& vertex : vertices) {
+        bounds = Union(bounds, vertex.si.p);
+    }
+
+    cellSize = 2 * radius;
+    cellEnds.assign(std::max(vertexCount, 1), 0);
+    indices.resize(vertexCount);
+
+    // counting sort of the vertices by bucket
+    for (const LightVertex& vertex : vertices) {
+        ++cellEnds[Hash(Cell(vertex.si.p))];
+    }
+
+    int sum = 0;
+    for (int& end : cellEnds) {
+        int count = end;
+        end = sum;
+        sum += count;
+    }
+
+    for (int i = 0; i < vertexCount; ++i) {
+        indices[cellEnds[Hash(Cell(vertices[i].si.p))]++] = i;
+    }
+}
+
+}
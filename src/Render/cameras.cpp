@@ -12,6 +12,12 @@ CameraRaySample PerspectiveCamera::GenerateRay(const Point2& pFilm, const Point2
     Float posPdf = 1;
     Float dirPdf = 1;
 
+    // rays through the pixels one to the right and one below share the lens sample
+    ray.hasDifferentials = true;
+    ray.rxOrigin = ray.ryOrigin = ray.o;
+    ray.rxDirection = Normalize(mRasterToCamera_(Point3(pFilm.x + 1, pFilm.y, 0)) - Point3(0, 0, 0));
+    ray.ryDirection = Normalize(mRasterToCamera_(Point3(pFilm.x, pFilm.y + 1, 0)) - Point3(0, 0, 0));
+
     if(mLenRadius_ > 0) {
         Point2 sp = UniformSampleDisk(sample);
         Point3 pLen = Point3(sp.x, sp.y, 0) * mLenRadius_;
@@ -21,6 +27,12 @@ CameraRaySample PerspectiveCamera::GenerateRay(const Point2& pFilm, const Point2
         ray.o = Point3(pLen.x, pLen.y, 0);
         ray.d = Normalize(pFocus - ray.o);
 
+        Point3 pFocusX = ray.rxOrigin + ray.rxDirection * (mFocalDistance_ / ray.rxDirection.z);
+        Point3 pFocusY = ray.ryOrigin + ray.ryDirection * (mFocalDistance_ / ray.ryDirection.z);
+        ray.rxOrigin = ray.ryOrigin = ray.o;
+        ray.rxDirection = Normalize(pFocusX - ray.o);
+        ray.ryDirection = Normalize(pFocusY - ray.o);
+
         posPdf = 1 / (Pi * mLenRadius_ * mLenRadius_);
     }
     dirPdf = 1 / (A * cosTheta * cosTheta * cosTheta);
@@ -0,0 +1,130 @@
+#include <RayFlow/Render/denoiser.h>
+#include <RayFlow/Util/parallel.h>
+
+namespace rayflow {
+
+void Denoiser::Denoise(const Point2i& resolution, const Spectrum* color, const AOVPixel* features, Spectrum* output) const {
+    int pixelCount = resolution.x * resolution.y;
+    constexpr Float AlbedoEpsilon = 1e-3f;
+
+    FeatureBuffers buffers;
+    buffers.normalX.resize(pixelCount);
+    buffers.normalY.resize(pixelCount);
+    buffers.normalZ.resize(pixelCount);
+    buffers.depth.resize(pixelCount);
+
+    std::vector<Spectrum> albedo(pixelCount);
+    std::vector<Spectrum> current(pixelCount);
+    std::vector<Spectrum> next(pixelCount);
+    std::vector<Float> variance(pixelCount);
+    std::vector<Float> nextVariance(pixelCount);
+
+    for (int i = 0; i < pixelCount; ++i) {
+        const AOVPixel& pixel = features[i];
+        Float invCount = pixel.sampleCount > 0 ? Float(1) / pixel.sampleCount : 0;
+
+        Vector3 n = pixel.normal * invCount;
+        Float length = Length(n);
+        if (length > 0) {
+            n = n / length;
+        }
+        buffers.normalX[i] = n.x;
+        buffers.normalY[i] = n.y;
+        buffers.normalZ[i] = n.z;
+        buffers.depth[i] = pixel.depth * invCount;
+
+        // untextured irradiance, channels without albedo keep the radiance
+        Spectrum a = pixel.albedo * invCount;
+        for (int c = 0; c < Spectrum::nSamples; ++c) {
+            a[c] = a[c] > AlbedoEpsilon ? a[c] : 1;
+        }
+        albedo[i] = a;
+        current[i] = color[i] / a;
+
+        // variance of the pixel mean, moved to the scale of the irradiance
+        Float mean = pixel.luminanceSum * invCount;
+        Float sampleVariance = std::max<Float>(pixel.luminanceSquareSum * invCount - mean * mean, 0);
+        Float albedoLuminance = std::max<Float>(a.Luminance(), AlbedoEpsilon);
+        variance[i] = sampleVariance * invCount / (albedoLuminance * albedoLuminance);
+    }
+
+    for (int iteration = 0; iteration < mIterations_; ++iteration) {
+        FilterIteration(resolution, 1 << iteration, buffers, current, variance, next, nextVariance);
+        std::swap(current, next);
+        std::swap(variance, nextVariance);
+    }
+
+    for (int i = 0; i < pixelCount; ++i) {
+        output[i] = current[i] * albedo[i];
+    }
+}
+
+void Denoiser::FilterIteration(const Point2i& resolution, int step, const FeatureBuffers& features,
+                               const std::vector<Spectrum>& color, const std::vector<Float>& variance,
+                               std::vector<Spectrum>& filtered, std::vector<Float>& filteredVariance) const {
+    // B3 spline taps of the 5x5 kernel
+    static const Float kernel[3] = { 3.f / 8, 1.f / 4, 1.f / 16 };
+    constexpr Float Epsilon = 1e-6f;
+
+    int tileWidth = 16;
+    Point2i tileCount((resolution.x + tileWidth - 1) / tileWidth, (resolution.y + tileWidth - 1) / tileWidth);
+
+    Scheduler::Parallel2D(tileCount,
+        [&](Point2i tile) {
+            int x0 = tile.x * tileWidth;
+            int x1 = std::min(x0 + tileWidth, resolution.x);
+            int y0 = tile.y * tileWidth;
+            int y1 = std::min(y0 + tileWidth, resolution.y);
+
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    int p = y * resolution.x + x;
+                    Float luminanceP = color[p].Luminance();
+                    Float sigmaL = mSigmaLuminance_ * ::sqrt(variance[p]) + Epsilon;
+                    Float depthP = features.depth[p];
+                    Float sigmaZ = mSigmaDepth_ * depthP * step + Epsilon;
+                    bool hasNormalP = features.normalX[p] != 0 || features.normalY[p] != 0 || features.normalZ[p] != 0;
+
+                    Spectrum sum = kernel[0] * kernel[0] * color[p];
+                    Float sumVariance = kernel[0] * kernel[0] * kernel[0] * kernel[0] * variance[p];
+                    Float weightSum = kernel[0] * kernel[0];
+
+                    for (int dy = -2; dy <= 2; ++dy) {
+                        int qy = y + dy * step;
+                        if (qy < 0 || qy >= resolution.y) {
+                            continue;
+                        }
+
+                        for (int dx = -2; dx <= 2; ++dx) {
+                            int qx = x + dx * step;
+                            if (qx < 0 || qx >= resolution.x || (dx == 0 && dy == 0)) {
+                                continue;
+                            }
+
+                            int q = qy * resolution.x + qx;
+                            Float cosNormal = features.normalX[p] * features.normalX[q] +
+                                              features.normalY[p] * features.normalY[q] +
+                                              features.normalZ[p] * features.normalZ[q];
+                            bool hasNormalQ = features.normalX[q] != 0 || features.normalY[q] != 0 || features.normalZ[q] != 0;
+
+                            // pixels without a hit only blend with each other
+                            Float wN = hasNormalP || hasNormalQ ? ::pow(std::max<Float>(cosNormal, 0), mSigmaNormal_) : 1;
+                            Float wZ = ::exp(-std::abs(depthP - features.depth[q]) / sigmaZ);
+                            Float wL = ::exp(-std::abs(luminanceP - color[q].Luminance()) / sigmaL);
+                            Float w = kernel[std::abs(dx)] * kernel[std::abs(dy)] * wN * wZ * wL;
+
+                            sum += w * color[q];
+                            sumVariance += w * w * variance[q];
+                            weightSum += w;
+                        }
+                    }
+
+                    filtered[p] = sum / weightSum;
+                    filteredVariance[p] = sumVariance / (weightSum * weightSum);
+                }
+            }
+        }
+    );
+}
+
+}
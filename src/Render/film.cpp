@@ -1,7 +1,40 @@
 #include <RayFlow/Render/film.h>
+#include <RayFlow/Render/denoiser.h>
+#include <RayFlow/Util/exr.h>
 
 namespace rayflow {
 
+namespace {
+
+// index of the calling thread into the splat buffers. The arena thread index is not used, the scheduler
+// runs every call in a new arena and a thread can hold different indices in nested arenas
+int ThreadSlot() {
+    static std::atomic<int> nextSlot{ 0 };
+    thread_local int slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+// streams an image to an EXR file in blocks of rows, channels(i, values) fills the channels of pixel i
+template <typename F>
+void StreamEXR(const std::string& filename, const Point2i& resolution, const std::vector<std::string>& channels,
+               EXRPixelType pixelType, F channelValues) {
+    constexpr int BlockRows = 16;
+    EXRWriter writer(filename, resolution, channels, pixelType);
+    std::vector<float> block(size_t(BlockRows) * resolution.x * channels.size());
+
+    for (int y0 = 0; y0 < resolution.y && writer.IsOpen(); y0 += BlockRows) {
+        int rowCount = std::min(BlockRows, resolution.y - y0);
+
+        for (int i = 0; i < rowCount * resolution.x; ++i) {
+            channelValues(y0 * resolution.x + i, &block[i * channels.size()]);
+        }
+
+        writer.WriteScanlines(rowCount, block.data());
+    }
+}
+
+}
+
 FilmTile* Film::GetFilmTile(const AABB2i &sampleBounds) {
     Vector2 halfPixel(0.5f, 0.5f);
     Vector2 filterRadius = mFilter_->Radius();
@@ -11,17 +44,31 @@ FilmTile* Film::GetFilmTile(const AABB2i &sampleBounds) {
     Point2i p0(std::ceil(p0f.x), std::ceil(p0f.y));
     Point2i p1(std::floor(p1f.x) + 1, std::floor(p1f.y) + 1);
     
-    AABB2i tileBounds = Intersect(bounds, AABB2i(p0, p1));
+    AABB2i tileBounds = mFilterSampling_ ? Intersect(bounds, sampleBounds) : Intersect(bounds, AABB2i(p0, p1));
+
+    bool singlePixel = dynamic_cast<const BoxFilter*>(mFilter_) && filterRadius.x <= 0.5f && filterRadius.y <= 0.5f;
+    FilmTile* tile = mAlloc_.new_object<FilmTile>(tileBounds, filterRadius, filterTable, filterTableWidth, singlePixel);
+    
+    if (HasAOVs()) {
+        tile->aovPixels.resize(tileBounds.Area());
+    }
 
-    return mAlloc_.new_object<FilmTile>(tileBounds, filterRadius, filterTable, filterTableWidth);
+    return tile;
 }
 
 void Film::MergeFilmTile(FilmTile* tile) {
+    if (mStreaming_) {
+        AppendTileRecord(tile->GetBounds(), tile->pixels.data(), false);
+        return;
+    }
+
     const AABB2i& bounds = tile->GetBounds();
     const Point2i& pMin = bounds.pMin;
     const Point2i& pMax = bounds.pMax;
     
     for (int y = pMin.y; y < pMax.y; ++y) {
+        std::lock_guard<std::mutex> lock(mMergeMutexes_[y % mergeStripeCount]);
+
         for (int x = pMin.x; x < pMax.x; ++x) {
             const Point2i pixelPos(x, y);
             Pixel& pixel = GetPixel(pixelPos);
@@ -32,6 +79,24 @@ void Film::MergeFilmTile(FilmTile* tile) {
             pixel.rgb[2] += ftPixel.L[2];
 
             pixel.weightSum += ftPixel.weightSum;
+
+            // several passes may sample the pixel, features add up and the ids stay those of the first hit
+            if (tile->HasAOVs()) {
+                const AOVPixel& ftAOV = tile->aovPixels[(y - pMin.y) * (pMax.x - pMin.x) + (x - pMin.x)];
+                AOVPixel& aov = mAOVPixels_[y * resolution.x + x];
+
+                if (ftAOV.sampleCount > 0 && aov.sampleCount == 0) {
+                    aov.primitiveId = ftAOV.primitiveId;
+                    aov.materialId = ftAOV.materialId;
+                }
+
+                aov.albedo += ftAOV.albedo;
+                aov.normal += ftAOV.normal;
+                aov.depth += ftAOV.depth;
+                aov.sampleCount += ftAOV.sampleCount;
+                aov.luminanceSum += ftAOV.luminanceSum;
+                aov.luminanceSquareSum += ftAOV.luminanceSquareSum;
+            }
         }
     }
 }
@@ -40,44 +105,375 @@ void Film::AddSplat(const Point2f &p, Spectrum v) {
     Point2i pixlePos(::floor(p.x), ::floor(p.y));
 
     if (!InsideExclusive(pixlePos, bounds)) { return; }
-    Pixel& pixel = GetPixel(pixlePos);
 
-    pixel.splatRGB[0].Add(v[0]);
-    pixel.splatRGB[1].Add(v[1]);
-    pixel.splatRGB[2].Add(v[2]);
+    int thread = ThreadSlot();
+    int sharedBuffer = int(mSplatBuffers_.size()) - 1;
+    std::unique_lock<std::mutex> lock(mSharedSplatMutex_, std::defer_lock);
+
+    // threads beyond the number the buffers were sized for share the last buffer
+    if (thread >= sharedBuffer) {
+        thread = sharedBuffer;
+        lock.lock();
+    }
+
+    SplatBuffer& buffer = mSplatBuffers_[thread];
+    Point2i tile(pixlePos.x / splatTileWidth, pixlePos.y / splatTileWidth);
+    int tileIndex = tile.y * mSplatTileCount_.x + tile.x;
+    std::unique_ptr<Spectrum[]>& splats = buffer.tiles[tileIndex];
+
+    if (!splats) {
+        // a full buffer keeps its tiles, splats to any other tile are added to the pixels atomically
+        if (!mStreaming_ && buffer.residentTileCount >= maxResidentSplatTiles) {
+            Pixel& pixel = GetPixel(pixlePos);
+            pixel.splatRGB[0].Add(v[0]);
+            pixel.splatRGB[1].Add(v[1]);
+            pixel.splatRGB[2].Add(v[2]);
+            return;
+        }
+
+        splats.reset(new Spectrum[splatTileWidth * splatTileWidth]);
+        ++buffer.residentTileCount;
+    }
+
+    int x = pixlePos.x - tile.x * splatTileWidth;
+    int y = pixlePos.y - tile.y * splatTileWidth;
+    splats[y * splatTileWidth + x] += v;
+}
+
+void Film::ResolveSplats() {
+    Scheduler::Parallel2D(mSplatTileCount_,
+        [&](Point2i tile) {
+            int tileIndex = tile.y * mSplatTileCount_.x + tile.x;
+            int x0 = tile.x * splatTileWidth;
+            int y0 = tile.y * splatTileWidth;
+            int x1 = std::min(x0 + splatTileWidth, resolution.x);
+            int y1 = std::min(y0 + splatTileWidth, resolution.y);
+
+            // the threads' splats of the tile become one record
+            if (mStreaming_) {
+                std::vector<FilmTilePixel> sum((x1 - x0) * (y1 - y0));
+                bool any = false;
+
+                for (SplatBuffer& buffer : mSplatBuffers_) {
+                    std::unique_ptr<Spectrum[]>& splats = buffer.tiles[tileIndex];
+
+                    if (!splats) {
+                        continue;
+                    }
+
+                    for (int y = y0; y < y1; ++y) {
+                        for (int x = x0; x < x1; ++x) {
+                            sum[(y - y0) * (x1 - x0) + (x - x0)].L += splats[(y - y0) * splatTileWidth + (x - x0)];
+                        }
+                    }
+
+                    splats.reset();
+                    any = true;
+                }
+
+                if (any) {
+                    AppendTileRecord(AABB2i(Point2i(x0, y0), Point2i(x1, y1)), sum.data(), true);
+                }
+                return;
+            }
+
+            for (SplatBuffer& buffer : mSplatBuffers_) {
+                std::unique_ptr<Spectrum[]>& splats = buffer.tiles[tileIndex];
+
+                if (!splats) {
+                    continue;
+                }
+
+                // the tile belongs to this task alone, plain stores are enough
+                for (int y = y0; y < y1; ++y) {
+                    for (int x = x0; x < x1; ++x) {
+                        const Spectrum& v = splats[(y - y0) * splatTileWidth + (x - x0)];
+                        Pixel& pixel = GetPixel(Point2i(x, y));
+
+                        pixel.splatRGB[0] = pixel.splatRGB[0] + v[0];
+                        pixel.splatRGB[1] = pixel.splatRGB[1] + v[1];
+                        pixel.splatRGB[2] = pixel.splatRGB[2] + v[2];
+                    }
+                }
+
+                splats.reset();
+            }
+        }
+    );
+
+    for (SplatBuffer& buffer : mSplatBuffers_) {
+        buffer.residentTileCount = 0;
+    }
 }
 
 void Film::Write(Float lightImageScale)  {
     const int width = resolution.x;
-    for (int y = 0; y < resolution.y; ++y) {
-        for (int x = 0; x < resolution.x; ++x) {
-            const Point2i pixelPos(x, y);
-            Pixel& pixel = GetPixel(pixelPos);
-            Float* rgb = pixel.rgb;
-            const AtomicFloat* splatRGB = pixel.splatRGB;
-            const Float& ws = pixel.weightSum;
-            if (ws != 0) {
-                rgb[0] /= ws;
-                rgb[1] /= ws;
-                rgb[2] /= ws;
+    ResolveSplats();
+
+    if (mStreaming_) {
+        WriteStreamed(lightImageScale);
+        return;
+    }
+
+    // rows are normalized and quantized independently, in chunks of 16
+    int rowChunkCount = (resolution.y + 15) / 16;
+    Scheduler::Parallel1D(rowChunkCount, 1,
+        [&](int begin, int end) {
+            for (int y = begin * 16; y < std::min(end * 16, resolution.y); ++y) {
+                for (int x = 0; x < width; ++x) {
+                    const Point2i pixelPos(x, y);
+                    Pixel& pixel = GetPixel(pixelPos);
+                    Float* rgb = pixel.rgb;
+                    const AtomicFloat* splatRGB = pixel.splatRGB;
+                    const Float& ws = pixel.weightSum;
+                    if (ws != 0) {
+                        Float invWeight = 1 / ws;
+                        rgb[0] *= invWeight;
+                        rgb[1] *= invWeight;
+                        rgb[2] *= invWeight;
+                    }
+
+                    rgb[0] += lightImageScale * splatRGB[0];
+                    rgb[1] += lightImageScale * splatRGB[1];
+                    rgb[2] += lightImageScale * splatRGB[2];
+
+                    mBitMap_->SetPixel(pixelPos, Spectrum(rgb));
+                }
+            }
+        }
+    );
+
+    // exr keeps the unclamped linear radiance, the 8 bit bitmap only serves display
+    if (IsEXR()) {
+        StreamEXR(mFilename_, resolution, { "R", "G", "B" }, EXRPixelType::EHalf,
+            [&](int i, float* values) {
+                values[0] = mPixels_[i].rgb[0];
+                values[1] = mPixels_[i].rgb[1];
+                values[2] = mPixels_[i].rgb[2];
             }
+        );
+    }
+    else {
+        mBitMap_->Write(mFilename_);
+    }
+
+    if (HasAOVs()) {
+        WriteAOVs();
+    }
 
-            rgb[0] += lightImageScale * splatRGB[0];
-            rgb[1] += lightImageScale * splatRGB[1];
-            rgb[2] += lightImageScale * splatRGB[2];
+    if (mDenoiser_ && HasAOVs()) {
+        int pixelCount = resolution.x * resolution.y;
+        std::vector<Spectrum> image(pixelCount);
+        std::vector<Spectrum> denoised(pixelCount);
 
-            mBitMap_->SetPixel(Point2i(x, y), Spectrum(rgb));
+        for (int i = 0; i < pixelCount; ++i) {
+            image[i] = Spectrum(mPixels_[i].rgb);
         }
+
+        mDenoiser_->Denoise(resolution, image.data(), mAOVPixels_.data(), denoised.data());
+
+        size_t dot = mFilename_.find_last_of('.');
+        std::string denoisedFilename = mFilename_.substr(0, dot) + "_denoised" + mFilename_.substr(dot);
+
+        if (IsEXR()) {
+            StreamEXR(denoisedFilename, resolution, { "R", "G", "B" }, EXRPixelType::EHalf,
+                [&](int i, float* values) {
+                    values[0] = denoised[i][0];
+                    values[1] = denoised[i][1];
+                    values[2] = denoised[i][2];
+                }
+            );
+            return;
+        }
+
+        for (int y = 0; y < resolution.y; ++y) {
+            for (int x = 0; x < resolution.x; ++x) {
+                mBitMap_->SetPixel(Point2i(x, y), denoised[y * resolution.x + x]);
+            }
+        }
+
+        mBitMap_->Write(denoisedFilename);
     }
+}
 
-    mBitMap_->Write(mFilename_);
+std::string Film::TileFilename() const {
+    return mFilename_.substr(0, mFilename_.find_last_of('.')) + ".tiles";
+}
+
+void Film::AppendTileRecord(const AABB2i& recordBounds, const FilmTilePixel* pixels, bool splat) {
+    std::lock_guard<std::mutex> lock(mTileFileMutex_);
+
+    if (!mTileFile_.is_open()) {
+        mTileFile_.open(TileFilename(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!mTileFile_.is_open()) {
+            std::cout << "ERROR::Failed to open [ " << TileFilename() << " ]\n";
+            return;
+        }
+    }
+
+    mTileRecords_.push_back(TileRecord{ recordBounds, std::streamoff(mTileFile_.tellp()), splat });
+    mTileFile_.write(reinterpret_cast<const char*>(pixels), std::streamsize(recordBounds.Area()) * sizeof(FilmTilePixel));
+}
+
+void Film::WriteStreamed(Float lightImageScale) {
+    std::string filename = mFilename_;
+    if (!IsEXR()) {
+        filename = mFilename_.substr(0, mFilename_.find_last_of('.')) + ".exr";
+        std::cout << "A streaming film is written as [ " << filename << " ]\n";
+    }
+
+    if (!mTileFile_.is_open()) {
+        std::cout << "ERROR::No tiles were merged into the film\n";
+        return;
+    }
+    mTileFile_.flush();
+
+    // records sorted by their first row, a band only visits the records that can reach it
+    std::sort(mTileRecords_.begin(), mTileRecords_.end(),
+              [](const TileRecord& a, const TileRecord& b) { return a.bounds.pMin.y < b.bounds.pMin.y; });
+    int maxHeight = 0;
+    for (const TileRecord& record : mTileRecords_) {
+        maxHeight = std::max(maxHeight, record.bounds.pMax.y - record.bounds.pMin.y);
+    }
+
+    constexpr int BandRows = 16;
+    const int width = resolution.x;
+    std::vector<FilmTilePixel> band(size_t(BandRows) * width);
+    std::vector<Spectrum> splats(size_t(BandRows) * width);
+    std::vector<FilmTilePixel> row(width);
+    std::vector<float> rgb(size_t(BandRows) * width * 3);
+    EXRWriter writer(filename, resolution, { "R", "G", "B" }, EXRPixelType::EHalf);
+
+    for (int y0 = 0; y0 < resolution.y && writer.IsOpen(); y0 += BandRows) {
+        int y1 = std::min(y0 + BandRows, resolution.y);
+        std::fill(band.begin(), band.end(), FilmTilePixel{ Spectrum(0.f), 0 });
+        std::fill(splats.begin(), splats.end(), Spectrum(0.f));
+
+        auto first = std::lower_bound(mTileRecords_.begin(), mTileRecords_.end(), y0 - maxHeight,
+            [](const TileRecord& record, int y) { return record.bounds.pMin.y < y; });
+
+        for (auto record = first; record != mTileRecords_.end() && record->bounds.pMin.y < y1; ++record) {
+            const AABB2i& b = record->bounds;
+            int recordWidth = b.pMax.x - b.pMin.x;
+
+            for (int y = std::max(y0, b.pMin.y); y < std::min(y1, b.pMax.y); ++y) {
+                mTileFile_.seekg(record->offset + std::streamoff(y - b.pMin.y) * recordWidth * sizeof(FilmTilePixel));
+                mTileFile_.read(reinterpret_cast<char*>(row.data()), std::streamsize(recordWidth) * sizeof(FilmTilePixel));
+
+                for (int x = b.pMin.x; x < b.pMax.x; ++x) {
+                    size_t offset = size_t(y - y0) * width + x;
+                    const FilmTilePixel& pixel = row[x - b.pMin.x];
+
+                    if (record->splat) {
+                        splats[offset] += pixel.L;
+                    }
+                    else {
+                        band[offset].L += pixel.L;
+                        band[offset].weightSum += pixel.weightSum;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < (y1 - y0) * width; ++i) {
+            Float invWeight = band[i].weightSum != 0 ? 1 / band[i].weightSum : 0;
+            for (int c = 0; c < 3; ++c) {
+                rgb[i * 3 + c] = band[i].L[c] * invWeight + lightImageScale * splats[i][c];
+            }
+        }
+
+        writer.WriteScanlines(y1 - y0, rgb.data());
+    }
+
+    mTileFile_.close();
+    mTileRecords_.clear();
+    std::remove(TileFilename().c_str());
+}
+
+bool Film::IsEXR() const {
+    return mFilename_.substr(mFilename_.find_last_of('.') + 1) == "exr";
+}
+
+void Film::WriteAOVs() const {
+    std::string stem = mFilename_.substr(0, mFilename_.find_last_of('.'));
+    int pixelCount = resolution.x * resolution.y;
+
+    // one multi channel file, float so that ids stay exact
+    if (IsEXR()) {
+        StreamEXR(stem + "_aovs.exr", resolution,
+            { "albedo.R", "albedo.G", "albedo.B", "normal.X", "normal.Y", "normal.Z",
+              "depth.Z", "primitive.id", "material.id", "spp.count" },
+            EXRPixelType::EFloat,
+            [&](int i, float* values) {
+                const AOVPixel& pixel = mAOVPixels_[i];
+                Float invCount = pixel.sampleCount > 0 ? Float(1) / pixel.sampleCount : 0;
+
+                for (int c = 0; c < 3; ++c) {
+                    values[c] = pixel.albedo[c] * invCount;
+                    values[3 + c] = pixel.normal[c] * invCount;
+                }
+                values[6] = pixel.depth * invCount;
+                values[7] = pixel.primitiveId;
+                values[8] = pixel.materialId;
+                values[9] = pixel.sampleCount;
+            }
+        );
+        return;
+    }
+
+    std::vector<float> albedo(pixelCount * 3);
+    std::vector<float> normal(pixelCount * 3);
+    std::vector<float> depth(pixelCount);
+    std::vector<float> primitiveId(pixelCount);
+    std::vector<float> materialId(pixelCount);
+    std::vector<float> sampleCount(pixelCount);
+
+    for (int i = 0; i < pixelCount; ++i) {
+        const AOVPixel& pixel = mAOVPixels_[i];
+        Float invCount = pixel.sampleCount > 0 ? Float(1) / pixel.sampleCount : 0;
+
+        for (int c = 0; c < 3; ++c) {
+            albedo[i * 3 + c] = pixel.albedo[c] * invCount;
+            normal[i * 3 + c] = pixel.normal[c] * invCount;
+        }
+        depth[i] = pixel.depth * invCount;
+        primitiveId[i] = pixel.primitiveId;
+        materialId[i] = pixel.materialId;
+        sampleCount[i] = pixel.sampleCount;
+    }
+
+    auto write = [&](const char* name, BitMapPixelFormat format, std::vector<float>& data) {
+        BitMap bitmap(format, BitMapComponentFormat::EFloat32, resolution, (uint8_t*)data.data());
+        bitmap.Write(stem + "_" + name + ".pfm");
+    };
+
+    write("albedo", BitMapPixelFormat::ERGB, albedo);
+    write("normal", BitMapPixelFormat::ERGB, normal);
+    write("depth", BitMapPixelFormat::EFLOAT, depth);
+    write("primitive", BitMapPixelFormat::EFLOAT, primitiveId);
+    write("material", BitMapPixelFormat::EFLOAT, materialId);
+    write("spp", BitMapPixelFormat::EFLOAT, sampleCount);
 }   
 
-void FilmTile::AddSample(const Point2& pFilm, const Spectrum& L, const Spectrum& importance) {
+template <bool SinglePixel>
+void FilmTile::Splat(const Point2& pFilm, const Spectrum& L) {
+    if constexpr (SinglePixel) {
+        // the box table is 1 everywhere
+        Point2i p(::floor(pFilm.x), ::floor(pFilm.y));
+
+        if (InsideExclusive(p, bounds)) {
+            FilmTilePixel& pixel = GetPixel(p);
+            pixel.L += L;
+            pixel.weightSum += 1;
+        }
+        return;
+    }
+
     Vector2 halfPixel(0.5f, 0.5f);
     Point2 pFilmDiscrete = pFilm - halfPixel;
-    Point2 p0f = pFilm - filterRadius;
-    Point2 p1f = pFilm + filterRadius;
+    Point2 p0f = pFilmDiscrete - filterRadius;
+    Point2 p1f = pFilmDiscrete + filterRadius;
 
     Point2i p0(std::ceil(p0f.x), std::ceil(p0f.y));
     Point2i p1(std::floor(p1f.x) + 1, std::floor(p1f.y) + 1);
@@ -85,16 +481,34 @@ void FilmTile::AddSample(const Point2& pFilm, const Spectrum& L, const Spectrum&
     p0 = Max(p0, bounds.pMin);
     p1 = Min(p1, bounds.pMax);
 
-    rstd::vector<int> ftX(p1.x - p0.x);
+    auto tableOffset = [&](int i, Float pDiscrete, Float invRadius) {
+        Float offset = std::abs((i - pDiscrete) * invRadius * filterTableWidth);
+        return std::min((int)offset, filterTableWidth - 1);
+    };
+
+    // filters wider than the stack footprint look the table offsets up per pixel
+    if (p1.x - p0.x > maxFootprintWidth || p1.y - p0.y > maxFootprintWidth) {
+        for (int y = p0.y; y < p1.y; ++y) {
+            int row = tableOffset(y, pFilmDiscrete.y, invFilterRadius.y) * filterTableWidth;
+            for (int x = p0.x; x < p1.x; ++x) {
+                Float weight = filterTable[row + tableOffset(x, pFilmDiscrete.x, invFilterRadius.x)];
+
+                FilmTilePixel& pixel = GetPixel(Point2i(x, y));
+                pixel.L += weight * L;
+                pixel.weightSum += weight;
+            }
+        }
+        return;
+    }
+
+    int ftX[maxFootprintWidth];
     for (int i = p0.x; i < p1.x; ++i) {
-        float offset = std::abs((p0.x - pFilmDiscrete.x) * invFilterRadius.x * filterTableWidth);
-        ftX[i - p0.x] = std::min((int)std::floor(offset), filterTableWidth - 1);
+        ftX[i - p0.x] = tableOffset(i, pFilmDiscrete.x, invFilterRadius.x);
     }
 
-    rstd::vector<int> ftY(p1.y - p0.y);
+    int ftY[maxFootprintWidth];
     for (int i = p0.y; i < p1.y; ++i) {
-        float offset = std::abs((p0.y - pFilmDiscrete.y) * invFilterRadius.y * filterTableWidth);
-        ftY[i - p0.y] = std::min((int)std::floor(offset), filterTableWidth - 1);
+        ftY[i - p0.y] = tableOffset(i, pFilmDiscrete.y, invFilterRadius.y);
     }
 
     for (int y = p0.y; y < p1.y; ++y) {
@@ -103,10 +517,68 @@ void FilmTile::AddSample(const Point2& pFilm, const Spectrum& L, const Spectrum&
             Float weight = filterTable[offset];
             
             FilmTilePixel& pixel = GetPixel(Point2i(x, y));
-            pixel.L += weight * importance * L;
+            pixel.L += weight * L;
             pixel.weightSum += weight;
         }
     }
 }
 
+void FilmTile::AddSample(const Point2& pFilm, const Spectrum& L, const Spectrum& importance) {
+    Spectrum weighted(importance * L);
+
+    if (singlePixel) {
+        Splat<true>(pFilm, weighted);
+    }
+    else {
+        Splat<false>(pFilm, weighted);
+    }
+
+    AddLuminance(Point2i(::floor(pFilm.x), ::floor(pFilm.y)), weighted);
+}
+
+void FilmTile::AddPixelSample(const Point2i& p, const Spectrum& L, Float weight) {
+    if (!InsideExclusive(p, bounds)) {
+        return;
+    }
+
+    FilmTilePixel& pixel = GetPixel(p);
+    pixel.L += weight * L;
+    pixel.weightSum += weight;
+
+    AddLuminance(p, L);
+}
+
+void FilmTile::AddLuminance(const Point2i& p, const Spectrum& L) {
+    if (aovPixels.empty() || !InsideExclusive(p, bounds)) {
+        return;
+    }
+
+    int width = bounds.pMax.x - bounds.pMin.x;
+    AOVPixel& aovPixel = aovPixels[(p.x - bounds.pMin.x) + (p.y - bounds.pMin.y) * width];
+    Float luminance = L.Luminance();
+    aovPixel.luminanceSum += luminance;
+    aovPixel.luminanceSquareSum += luminance * luminance;
+}
+
+void FilmTile::AddAOVSample(const Point2& pFilm, const AOVSample& aov) {
+    Point2i p(::floor(pFilm.x), ::floor(pFilm.y));
+
+    if (aovPixels.empty() || !InsideExclusive(p, bounds)) {
+        return;
+    }
+
+    int width = bounds.pMax.x - bounds.pMin.x;
+    AOVPixel& pixel = aovPixels[(p.x - bounds.pMin.x) + (p.y - bounds.pMin.y) * width];
+
+    pixel.albedo += aov.albedo;
+    pixel.normal += Vector3(aov.normal);
+    pixel.depth += aov.depth;
+
+    if (pixel.sampleCount == 0) {
+        pixel.primitiveId = aov.primitiveId;
+        pixel.materialId = aov.materialId;
+    }
+    ++pixel.sampleCount;
+}
+
 }
\ No newline at end of file
@@ -2,5 +2,89 @@
 
 namespace rayflow {
 
+AliasTable::AliasTable(const rstd::vector<Float>& weights) :
+    mBins_(weights.size()) {
+    int n = weights.size();
+
+    if (n == 0) {
+        return;
+    }
+
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += std::max<Float>(weights[i], 0);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        mBins_[i].p = sum > 0 ? std::max<Float>(weights[i], 0) / sum : Float(1) / n;
+    }
+
+    // scaled probabilities, split into under and over full bins
+    rstd::vector<double> scaled(n);
+    rstd::vector<int> under;
+    rstd::vector<int> over;
+    for (int i = 0; i < n; ++i) {
+        scaled[i] = double(mBins_[i].p) * n;
+        if (scaled[i] < 1) {
+            under.push_back(i);
+        }
+        else {
+            over.push_back(i);
+        }
+    }
+
+    while (!under.empty() && !over.empty()) {
+        int u = under.back();
+        int o = over.back();
+        under.pop_back();
+        over.pop_back();
+
+        mBins_[u].q = scaled[u];
+        mBins_[u].alias = o;
+
+        scaled[o] -= 1 - scaled[u];
+        if (scaled[o] < 1) {
+            under.push_back(o);
+        }
+        else {
+            over.push_back(o);
+        }
+    }
+
+    // remaining bins are full up to floating point error
+    while (!under.empty()) {
+        mBins_[under.back()].q = 1;
+        mBins_[under.back()].alias = -1;
+        under.pop_back();
+    }
+
+    while (!over.empty()) {
+        mBins_[over.back()].q = 1;
+        mBins_[over.back()].alias = -1;
+        over.pop_back();
+    }
+}
+
+AliasLightSampler::AliasLightSampler(const std::vector<Light*>& lights) :
+    LightSampler(lights) {
+    int n = mLights_.size();
+    rstd::vector<Float> powers(n);
+    for (int i = 0; i < n; ++i) {
+        powers[i] = mLights_[i]->Power().Luminance();
+    }
+
+    mAliasTable_ = AliasTable(powers);
+}
+
+LightSampler* CreateLightSampler(LightSamplerType type, const std::vector<Light*>& lights) {
+    switch (type) {
+        case LightSamplerType::Power:
+            return new PowerLightSampler(lights);
+        case LightSamplerType::Alias:
+            return new AliasLightSampler(lights);
+        default:
+            return new UniformLightSampler(lights);
+    }
+}
 
 }
\ No newline at end of file
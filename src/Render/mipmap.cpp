@@ -0,0 +1,210 @@
+#include <RayFlow/Render/mipmap.h>
+#include <RayFlow/Render/texturecache.h>
+#include <RayFlow/Util/parallel.h>
+
+namespace rayflow {
+
+MIPMap::MIPMap(const BitMap& image, ImageTextureWrapMode wrapMode) :
+    mWrapMode_(wrapMode) {
+    std::vector<Point2i> resolutions = PyramidResolutions(image.GetResolution());
+    Point2i resolution = resolutions[0];
+    mLevels_.push_back(Level{ resolution, std::vector<Half>(3 * resolution.x * resolution.y) });
+
+    Scheduler::Parallel1D(resolution.y, 16,
+        [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                for (int x = 0; x < resolution.x; ++x) {
+                    mLevels_[0].Set(y * resolution.x + x, image.GetPixel<Spectrum>(Point2i(x, y)));
+                }
+            }
+        }
+    );
+
+    for (size_t i = 1; i < resolutions.size(); ++i) {
+        resolution = resolutions[i];
+        int above = Levels() - 1;
+        mLevels_.push_back(Level{ resolution, std::vector<Half>(3 * resolution.x * resolution.y) });
+        Level& level = mLevels_.back();
+
+        // a texel averages the 2x2 texels above it, an odd last row or column is dropped
+        Scheduler::Parallel1D(resolution.y, 16,
+            [&](int begin, int end) {
+                for (int y = begin; y < end; ++y) {
+                    for (int x = 0; x < resolution.x; ++x) {
+                        level.Set(y * resolution.x + x,
+                            (Texel(above, Point2i(2 * x, 2 * y)) + Texel(above, Point2i(2 * x + 1, 2 * y)) +
+                             Texel(above, Point2i(2 * x, 2 * y + 1)) + Texel(above, Point2i(2 * x + 1, 2 * y + 1))) * 0.25f);
+                    }
+                }
+            }
+        );
+    }
+}
+
+MIPMap::MIPMap(const TextureCache* cache, int textureId, ImageTextureWrapMode wrapMode) :
+    mWrapMode_(wrapMode),
+    mCache_(cache),
+    mTextureId_(textureId) {
+    for (const Point2i& resolution : cache->LevelResolutions(textureId)) {
+        mLevels_.push_back(Level{ resolution, {} });
+    }
+}
+
+std::vector<Point2i> MIPMap::PyramidResolutions(const Point2i& resolution) {
+    std::vector<Point2i> resolutions(1, resolution);
+
+    while (resolutions.back().x > 1 || resolutions.back().y > 1) {
+        Point2i above = resolutions.back();
+        resolutions.push_back(Point2i(std::max(above.x / 2, 1), std::max(above.y / 2, 1)));
+    }
+
+    return resolutions;
+}
+
+Spectrum MIPMap::Texel(int level, const Point2i& st) const {
+    const Level& l = mLevels_[level];
+    Point2i p(st);
+
+    if (mWrapMode_ == ImageTextureWrapMode::CLAMP) {
+        p.x = Clamp(p.x, 0, l.resolution.x - 1);
+        p.y = Clamp(p.y, 0, l.resolution.y - 1);
+    }
+    else {
+        p.x = Mod(p.x, l.resolution.x);
+        p.y = Mod(p.y, l.resolution.y);
+    }
+
+    if (mCache_) {
+        return mCache_->Texel(mTextureId_, level, p);
+    }
+
+    const Half* texel = &l.texels[3 * (p.y * l.resolution.x + p.x)];
+    Float rgb[3] = { Float(texel[0]), Float(texel[1]), Float(texel[2]) };
+    return Spectrum(rgb);
+}
+
+Spectrum MIPMap::Nearest(const Point2& st) const {
+    Point2i resolution = mLevels_[0].resolution;
+    return Texel(0, Point2i(::floor(st.x * resolution.x), ::floor(st.y * resolution.y)));
+}
+
+Spectrum MIPMap::Bilerp(int level, const Point2& st) const {
+    level = Clamp(level, 0, Levels() - 1);
+    Point2i resolution = mLevels_[level].resolution;
+
+    // texel centers lie at half integers
+    Float s = st.x * resolution.x - 0.5f;
+    Float t = st.y * resolution.y - 0.5f;
+    int s0 = ::floor(s);
+    int t0 = ::floor(t);
+    Float ds = s - s0;
+    Float dt = t - t0;
+
+    return (1 - ds) * (1 - dt) * Texel(level, Point2i(s0, t0)) +
+           ds * (1 - dt)       * Texel(level, Point2i(s0 + 1, t0)) +
+           (1 - ds) * dt       * Texel(level, Point2i(s0, t0 + 1)) +
+           ds * dt             * Texel(level, Point2i(s0 + 1, t0 + 1));
+}
+
+Spectrum MIPMap::Trilinear(const Point2& st, Float width) const {
+    Point2i resolution = mLevels_[0].resolution;
+    Float level = ::log2(std::max<Float>(width * std::max(resolution.x, resolution.y), 1e-8f));
+
+    if (level <= 0) {
+        return Bilerp(0, st);
+    }
+    if (level >= Levels() - 1) {
+        return Texel(Levels() - 1, Point2i(0, 0));
+    }
+
+    int iLevel = ::floor(level);
+    Float delta = level - iLevel;
+    return (1 - delta) * Bilerp(iLevel, st) + delta * Bilerp(iLevel + 1, st);
+}
+
+Spectrum MIPMap::EWA(const Point2& st, Vector2 dst0, Vector2 dst1) const {
+    if (LengthSquare(dst0) < LengthSquare(dst1)) {
+        Swap(dst0, dst1);
+    }
+
+    Float majorLength = Length(dst0);
+    Float minorLength = Length(dst1);
+
+    // the minor axis picks the level, it is lengthened so the filter stays within a few texels
+    if (minorLength * MaxAnisotropy < majorLength && minorLength > 0) {
+        Float scale = majorLength / (minorLength * MaxAnisotropy);
+        dst1 = dst1 * scale;
+        minorLength *= scale;
+    }
+
+    if (minorLength == 0) {
+        return Bilerp(0, st);
+    }
+
+    Point2i resolution = mLevels_[0].resolution;
+    Float level = std::max<Float>(0, ::log2(minorLength * std::max(resolution.x, resolution.y)));
+
+    if (level >= Levels() - 1) {
+        return Texel(Levels() - 1, Point2i(0, 0));
+    }
+
+    int iLevel = ::floor(level);
+    Float delta = level - iLevel;
+    return (1 - delta) * EWALevel(iLevel, st, dst0, dst1) + delta * EWALevel(iLevel + 1, st, dst0, dst1);
+}
+
+Spectrum MIPMap::EWALevel(int level, Point2 st, Vector2 dst0, Vector2 dst1) const {
+    // gaussian weights exp(-2 r^2) - exp(-2), indexed by the squared radius
+    static const std::vector<Float> weights = []() {
+        std::vector<Float> w(WeightTableSize);
+        for (int i = 0; i < WeightTableSize; ++i) {
+            Float r2 = Float(i) / (WeightTableSize - 1);
+            w[i] = ::exp(-2 * r2) - ::exp(Float(-2));
+        }
+        return w;
+    }();
+
+    Point2i resolution = mLevels_[level].resolution;
+    st.x = st.x * resolution.x - 0.5f;
+    st.y = st.y * resolution.y - 0.5f;
+    dst0 = Vector2(dst0.x * resolution.x, dst0.y * resolution.y);
+    dst1 = Vector2(dst1.x * resolution.x, dst1.y * resolution.y);
+
+    // implicit ellipse A s^2 + B s t + C t^2 = 1, at least a texel wide
+    Float A = dst0.y * dst0.y + dst1.y * dst1.y + 1;
+    Float B = -2 * (dst0.x * dst0.y + dst1.x * dst1.y);
+    Float C = dst0.x * dst0.x + dst1.x * dst1.x + 1;
+    Float invF = 1 / (A * C - B * B * 0.25f);
+    A *= invF;
+    B *= invF;
+    C *= invF;
+
+    Float det = -B * B + 4 * A * C;
+    Float invDet = 1 / det;
+    Float uSqrt = ::sqrt(det * C);
+    Float vSqrt = ::sqrt(A * det);
+    int s0 = ::ceil(st.x - 2 * invDet * uSqrt);
+    int s1 = ::floor(st.x + 2 * invDet * uSqrt);
+    int t0 = ::ceil(st.y - 2 * invDet * vSqrt);
+    int t1 = ::floor(st.y + 2 * invDet * vSqrt);
+
+    Spectrum sum(0.f);
+    Float weightSum = 0;
+    for (int it = t0; it <= t1; ++it) {
+        Float tt = it - st.y;
+        for (int is = s0; is <= s1; ++is) {
+            Float ss = is - st.x;
+            Float r2 = A * ss * ss + B * ss * tt + C * tt * tt;
+
+            if (r2 < 1) {
+                Float weight = weights[std::min<int>(r2 * WeightTableSize, WeightTableSize - 1)];
+                sum += weight * Texel(level, Point2i(is, it));
+                weightSum += weight;
+            }
+        }
+    }
+
+    return weightSum > 0 ? sum / weightSum : Bilerp(level, Point2((st.x + 0.5f) / resolution.x, (st.y + 0.5f) / resolution.y));
+}
+
+}
@@ -0,0 +1,98 @@
+#include <RayFlow/Render/reservoir.h>
+
+namespace rayflow {
+
+Float LightTargetPdf(const SurfaceIntersection& si, const BSDF& bsdf, const LightLiSample& ls) {
+    Spectrum contribution = bsdf.f(ls.wi, si.wo) * AbsDot(si.ns, ls.wi) * ls.L;
+    return std::max<Float>(contribution.Luminance(), 0);
+}
+
+LightReservoir ResampleLights(const Scene& scene, const SurfaceIntersection& si, const BSDF& bsdf,
+                              Sampler& sampler, int candidateCount, bool bsdfMIS) {
+    LightReservoir r;
+
+    for (int i = 0; i < candidateCount; ++i) {
+        SampledLight sampledLight = scene.SampleLight(si.p, sampler.Get1D());
+        Point2 u = sampler.Get2D();
+        Float uSelect = sampler.Get1D();
+
+        LightCandidate candidate;
+        Float weight = 0;
+        auto ls = sampledLight.light->SampleLi(si, u);
+
+        if (ls && ls->pdfDir != 0 && sampledLight.pdf != 0 && !ls->L.IsBlack()) {
+            candidate.light = sampledLight.light;
+            candidate.ls = *ls;
+            candidate.pHat = LightTargetPdf(si, bsdf, *ls);
+            Float pdfLight = sampledLight.pdf * ls->pdfDir;
+
+            if (bsdfMIS && !IsDeltaLight(sampledLight.light->type)) {
+                candidate.misWeight = PowerHeuristic(1, pdfLight, 1, bsdf.Pdf(ls->wi, si.wo));
+                candidate.pHat *= candidate.misWeight;
+            }
+
+            weight = candidate.pHat / pdfLight;
+        }
+
+        r.Update(candidate, weight, uSelect);
+    }
+
+    return r;
+}
+
+bool MergeReservoir(LightReservoir& r, const SurfaceIntersection& si, const BSDF& bsdf,
+                    const LightReservoir& neighbor, const Point3& pNeighbor, Float u) {
+    const LightCandidate& other = neighbor.sample;
+    LightCandidate candidate;
+    Float weight = 0;
+
+    if (other.light && neighbor.W() > 0) {
+        const Intersection& pLight = other.ls.pLight;
+        Float dist2 = DistanceSquare(pLight.p, si.p);
+
+        if (dist2 > 0) {
+            Vector3 wi = (pLight.p - si.p) / std::sqrt(dist2);
+            candidate.light = other.light;
+            candidate.ls = LightLiSample(other.light->Le(si, pLight), wi, other.ls.pdfPos, other.ls.pdfDir, pLight);
+            candidate.pHat = LightTargetPdf(si, bsdf, candidate.ls);
+
+            // W is a density in solid angle at the neighbor, convert it to solid angle at si
+            Float jacobian = 1;
+            if (!IsDeltaLight(other.light->type)) {
+                Float cosNeighbor = AbsDot(pLight.ng, other.ls.wi);
+                Float dist2Neighbor = DistanceSquare(pLight.p, pNeighbor);
+                jacobian = cosNeighbor > 0 ? AbsDot(pLight.ng, wi) * dist2Neighbor / (cosNeighbor * dist2) : 0;
+            }
+
+            weight = candidate.pHat * neighbor.W() * neighbor.M * jacobian;
+        }
+    }
+
+    int M = r.M;
+    bool selected = r.Update(candidate, weight, u);
+    r.M = M + neighbor.M;
+
+    return selected;
+}
+
+Spectrum ShadeReservoir(const Scene& scene, const SurfaceIntersection& si, const BSDF& bsdf,
+                        const LightReservoir& r) {
+    const LightCandidate& sample = r.sample;
+    Float W = r.W();
+
+    if (!sample.light || W == 0) {
+        return Spectrum(0.f);
+    }
+
+    VisibilityTester vis(si, sample.ls.pLight);
+
+    if (!vis.Visiable(scene)) {
+        return Spectrum(0.f);
+    }
+
+    Spectrum f = bsdf.f(sample.ls.wi, si.wo) * AbsDot(si.ns, sample.ls.wi);
+
+    return f * sample.ls.L * sample.misWeight * W;
+}
+
+}
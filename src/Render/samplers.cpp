@@ -34,8 +34,8 @@ void StratifiedSampler::StartPixel(const Point2i& pos) {
 }
 
 Sampler* StratifiedSampler::Clone(uint64_t seed) {
-    Sampler* sampler = new StratifiedSampler(*this);
-    rng.Reset(seed);
+    StratifiedSampler* sampler = new StratifiedSampler(*this);
+    sampler->rng.Reset(seed);
     return sampler;
 }
 
@@ -57,6 +57,205 @@ Point2 StratifiedSampler::Get2D() {
     }
 }
 
+Sampler* RandomSampler::Clone(uint64_t seed) {
+    RandomSampler* sampler = new RandomSampler(*this);
+    sampler->rng.Reset(seed);
+    return sampler;
+}
+
+Float RandomSampler::Get1D() {
+    return rng.UniformFloat();
+}
+
+Point2 RandomSampler::Get2D() {
+    return Point2(rng.UniformFloat(), rng.UniformFloat());
+}
+
+void SobolSampler::StartPixel(const Point2i& pos) {
+    Sampler::StartPixel(pos);
+    mDimension_ = 0;
+}
+
+void SobolSampler::Advance() {
+    Sampler::Advance();
+    mDimension_ = 0;
+}
+
+Sampler* SobolSampler::Clone(uint64_t seed) {
+    SobolSampler* sampler = new SobolSampler(*this);
+    sampler->mSeed_ = seed;
+    return sampler;
+}
+
+uint64_t SobolSampler::Hash() const {
+    uint64_t h = MixBits(mSeed_);
+    h = MixBits(h ^ uint32_t(mCurrentPixel.x));
+    h = MixBits(h ^ uint32_t(mCurrentPixel.y));
+    return MixBits(h ^ uint64_t(mDimension_));
+}
+
+Float SobolSampler::Get1D() {
+    uint64_t hash = Hash();
+    uint32_t index = PermutationElement(mCurrentSampleIndex_, mSampleCount_, uint32_t(hash));
+    ++mDimension_;
+
+    return OwenScrambledSobol(index, 0, uint32_t(hash >> 32));
+}
+
+Point2 SobolSampler::Get2D() {
+    uint64_t hash = Hash();
+    uint32_t index = PermutationElement(mCurrentSampleIndex_, mSampleCount_, uint32_t(hash));
+    mDimension_ += 2;
+
+    // the second dimension is scrambled with its own bits of the hash
+    return Point2(OwenScrambledSobol(index, 0, uint32_t(hash >> 32)),
+                  OwenScrambledSobol(index, 1, uint32_t(MixBits(hash) >> 32)));
+}
+
+PMJ02Sampler::PMJ02Sampler(size_t sampleCount, uint64_t seed, int setCount) :
+    Sampler(sampleCount),
+    mSeed_(seed),
+    mSetCount_(setCount),
+    mSetSize_(RoundUpPow2(int32_t(std::max<size_t>(sampleCount, 1)))) {
+    mPoints_ = std::make_shared<std::vector<uint32_t>>(size_t(mSetCount_) * mSetSize_ * 2);
+    std::vector<uint32_t>& points = *mPoints_;
+
+    for (int set = 0; set < mSetCount_; ++set) {
+        uint64_t hash = MixBits(MixBits(mSeed_) ^ uint64_t(set));
+
+        for (int i = 0; i < mSetSize_; ++i) {
+            size_t offset = (size_t(set) * mSetSize_ + i) * 2;
+            points[offset] = OwenScramble(SobolBits(i, 0), uint32_t(hash));
+            points[offset + 1] = OwenScramble(SobolBits(i, 1), uint32_t(hash >> 32));
+        }
+    }
+}
+
+void PMJ02Sampler::StartPixel(const Point2i& pos) {
+    Sampler::StartPixel(pos);
+    mDimension_ = 0;
+}
+
+void PMJ02Sampler::Advance() {
+    Sampler::Advance();
+    mDimension_ = 0;
+}
+
+Sampler* PMJ02Sampler::Clone(uint64_t seed) {
+    PMJ02Sampler* sampler = new PMJ02Sampler(*this);
+    sampler->mSeed_ = seed;
+    return sampler;
+}
+
+uint64_t PMJ02Sampler::Hash() const {
+    uint64_t h = MixBits(mSeed_);
+    h = MixBits(h ^ uint32_t(mCurrentPixel.x));
+    h = MixBits(h ^ uint32_t(mCurrentPixel.y));
+    return MixBits(h ^ uint64_t(mDimension_));
+}
+
+Float PMJ02Sampler::Get1D() {
+    uint64_t hash = Hash();
+    int set = int((hash >> 32) % mSetCount_);
+    size_t index = mCurrentSampleIndex_ & (mSetSize_ - 1);
+    ++mDimension_;
+
+    // xor with random digits moves whole elementary intervals, the stratification survives
+    uint32_t v = (*mPoints_)[(size_t(set) * mSetSize_ + index) * 2] ^ uint32_t(hash);
+    return std::min<Float>(v * 0x1p-32f, OneMinusEpsilon);
+}
+
+Point2 PMJ02Sampler::Get2D() {
+    uint64_t hash = Hash();
+    uint64_t digits = MixBits(hash);
+    int set = int((hash >> 32) % mSetCount_);
+    size_t index = mCurrentSampleIndex_ & (mSetSize_ - 1);
+    mDimension_ += 2;
+
+    const uint32_t* p = &(*mPoints_)[(size_t(set) * mSetSize_ + index) * 2];
+    return Point2(std::min<Float>((p[0] ^ uint32_t(digits)) * 0x1p-32f, OneMinusEpsilon),
+                  std::min<Float>((p[1] ^ uint32_t(digits >> 32)) * 0x1p-32f, OneMinusEpsilon));
+}
+
+ZSobolSampler::ZSobolSampler(size_t sampleCount, const Point2i& resolution, uint64_t seed) :
+    Sampler(sampleCount),
+    mSeed_(seed) {
+    // a sample count between two powers of two uses the first samples of the larger one
+    mLog2SampleCount_ = Log2Int(RoundUpPow2(int32_t(std::max<size_t>(sampleCount, 1))));
+    int res = RoundUpPow2(std::max(resolution.x, resolution.y));
+    mBase4Digits_ = Log2Int(res) + (mLog2SampleCount_ + 1) / 2;
+}
+
+void ZSobolSampler::StartPixel(const Point2i& pos) {
+    Sampler::StartPixel(pos);
+    mDimension_ = 0;
+    mMortonIndex_ = EncodeMorton2(uint32_t(pos.x), uint32_t(pos.y)) << mLog2SampleCount_;
+}
+
+void ZSobolSampler::Advance() {
+    Sampler::Advance();
+    mDimension_ = 0;
+    mMortonIndex_ = (mMortonIndex_ & ~((uint64_t(1) << mLog2SampleCount_) - 1)) | mCurrentSampleIndex_;
+}
+
+Sampler* ZSobolSampler::Clone(uint64_t) {
+    return new ZSobolSampler(*this);
+}
+
+Sampler* ZSobolSampler::ClonePass(uint64_t, int passIndex) {
+    ZSobolSampler* sampler = new ZSobolSampler(*this);
+    // MixBits(0) is 0, the first pass keeps the prototype's seed
+    sampler->mSeed_ = mSeed_ ^ MixBits(uint64_t(passIndex));
+    return sampler;
+}
+
+uint64_t ZSobolSampler::SampleIndex() const {
+    static const uint8_t permutations[24][4] = {
+        { 0, 1, 2, 3 }, { 0, 1, 3, 2 }, { 0, 2, 1, 3 }, { 0, 2, 3, 1 }, { 0, 3, 2, 1 }, { 0, 3, 1, 2 },
+        { 1, 0, 2, 3 }, { 1, 0, 3, 2 }, { 1, 2, 0, 3 }, { 1, 2, 3, 0 }, { 1, 3, 2, 0 }, { 1, 3, 0, 2 },
+        { 2, 1, 0, 3 }, { 2, 1, 3, 0 }, { 2, 0, 1, 3 }, { 2, 0, 3, 1 }, { 2, 3, 0, 1 }, { 2, 3, 1, 0 },
+        { 3, 1, 2, 0 }, { 3, 1, 0, 2 }, { 3, 2, 1, 0 }, { 3, 2, 0, 1 }, { 3, 0, 2, 1 }, { 3, 0, 1, 2 }
+    };
+
+    uint64_t sampleIndex = 0;
+    // an odd power of two leaves one base 2 digit at the bottom
+    bool odd = mLog2SampleCount_ & 1;
+    int lastDigit = odd ? 1 : 0;
+
+    // every base 4 digit is permuted depending on the digits above it and the dimension
+    for (int i = mBase4Digits_ - 1; i >= lastDigit; --i) {
+        int digitShift = 2 * i - (odd ? 1 : 0);
+        int digit = (mMortonIndex_ >> digitShift) & 3;
+        uint64_t higherDigits = mMortonIndex_ >> (digitShift + 2);
+        int p = (MixBits(higherDigits ^ (0x55555555u * uint64_t(mDimension_))) >> 24) % 24;
+        sampleIndex |= uint64_t(permutations[p][digit]) << digitShift;
+    }
+
+    if (odd) {
+        uint64_t digit = mMortonIndex_ & 1;
+        sampleIndex |= digit ^ (MixBits((mMortonIndex_ >> 1) ^ (0x55555555u * uint64_t(mDimension_))) & 1);
+    }
+
+    return sampleIndex;
+}
+
+Float ZSobolSampler::Get1D() {
+    uint64_t sampleIndex = SampleIndex();
+    uint64_t hash = MixBits(MixBits(mSeed_) ^ uint64_t(mDimension_));
+    ++mDimension_;
+
+    return OwenScrambledSobol(sampleIndex, 0, uint32_t(hash));
+}
+
+Point2 ZSobolSampler::Get2D() {
+    uint64_t sampleIndex = SampleIndex();
+    uint64_t hash = MixBits(MixBits(mSeed_) ^ uint64_t(mDimension_));
+    mDimension_ += 2;
+
+    return Point2(OwenScrambledSobol(sampleIndex, 0, uint32_t(hash)),
+                  OwenScrambledSobol(sampleIndex, 1, uint32_t(hash >> 32)));
+}
+
 void Stratified1D(Float* data, Rng& rng, int nSamples, bool jitter) {
     for (int i = 0; i < nSamples; ++i) {
         Float delta = jitter ? rng.UniformFloat() : 0.5f;
@@ -4,7 +4,79 @@
 
 namespace rayflow {
 rstd::optional<ShapeIntersection> Scene::Intersect(const Ray& ray, Float tMax) const {
-    return  mBVH_.Intersect(ray, tMax);
+    rstd::optional<ShapeIntersection> hit = mBVH_.Intersect(ray, tMax);
+
+    if (hit && ray.hasDifferentials) {
+        hit->isect.ComputeDifferentials(ray);
+    }
+
+    return hit;
+}
+
+bool Scene::IntersectP(const Ray& ray, Float tMax) const {
+    return mBVH_.IntersectP(ray, tMax);
+}
+
+void Scene::Occluded(ShadowRay* rays, int count) const {
+    if (count == 1) {
+        rays[0].occluded = mBVH_.IntersectP(rays[0].ray, rays[0].tMax);
+        return;
+    }
+
+    // rays are grouped by the octant of their direction and traced in packets of one octant
+    auto octant = [&](int i) {
+        const Vector3& d = rays[i].ray.d;
+        return (d.x < 0 ? 1 : 0) | (d.y < 0 ? 2 : 0) | (d.z < 0 ? 4 : 0);
+    };
+
+    int octantBegin[9] = {};
+    for (int i = 0; i < count; ++i) {
+        ++octantBegin[octant(i) + 1];
+    }
+    for (int o = 1; o < 9; ++o) {
+        octantBegin[o] += octantBegin[o - 1];
+    }
+
+    std::vector<int> order(count);
+    int octantEnd[8];
+    std::copy(octantBegin, octantBegin + 8, octantEnd);
+    for (int i = 0; i < count; ++i) {
+        order[octantEnd[octant(i)]++] = i;
+    }
+
+    Ray packet[BVH::PacketSize];
+    Float tMax[BVH::PacketSize];
+    bool occluded[BVH::PacketSize];
+
+    for (int o = 0; o < 8; ++o) {
+        for (int begin = octantBegin[o]; begin < octantBegin[o + 1]; begin += BVH::PacketSize) {
+            int packetCount = std::min(BVH::PacketSize, octantBegin[o + 1] - begin);
+
+            for (int k = 0; k < packetCount; ++k) {
+                packet[k] = rays[order[begin + k]].ray;
+                tMax[k] = rays[order[begin + k]].tMax;
+            }
+
+            mBVH_.IntersectP(packet, tMax, packetCount, occluded);
+
+            for (int k = 0; k < packetCount; ++k) {
+                rays[order[begin + k]].occluded = occluded[k];
+            }
+        }
+    }
+}
+
+int Scene::PrimitiveId(const SurfaceIntersection& si) const {
+    return si.primitive ? mBVH_.PrimitiveIndex(si.primitive) : -1;
+}
+
+int Scene::MaterialId(const SurfaceIntersection& si) const {
+    if (!si.primitive) {
+        return -1;
+    }
+
+    auto it = mMaterialIds_.find(si.primitive->GetMaterial());
+    return it == mMaterialIds_.end() ? -1 : it->second;
 }
 
 SampledLight Scene::SampleLight(const Point3& p, Float u) const {
@@ -19,4 +91,8 @@ const LightSampler* Scene::GetLightSampler() const {
     return mLightSampler_;
 }
 
+AABB3 Scene::Bounds() const {
+    return mBVH_.Bounds();
+}
+
 }
\ No newline at end of file
@@ -238,6 +238,19 @@ rstd::optional<ShapeIntersection> Triangle::Intersect(const Ray& ray, Float tMax
         isect.ng = Normal3(Normalize(Cross(e1, e2)));
         isect.ns = Normalize(alpha * n1 + beta * n2 + gamma * n3);
         isect.uv = alpha * tex1 + beta * tex2 + gamma * tex3;
+
+        // surface derivatives from the texture parameterization, degenerate uvs leave them 0
+        Vector2 duv13 = tex1 - tex3;
+        Vector2 duv23 = tex2 - tex3;
+        Float uvDet = duv13[0] * duv23[1] - duv13[1] * duv23[0];
+        if (std::abs(uvDet) > 1e-9f) {
+            Vector3 dp13 = p1 - p3;
+            Vector3 dp23 = p2 - p3;
+            Float invDet = 1 / uvDet;
+            isect.dpdu = (duv23[1] * dp13 - duv13[1] * dp23) * invDet;
+            isect.dpdv = (duv13[0] * dp23 - duv23[0] * dp13) * invDet;
+        }
+
         return ShapeIntersection{ isect, tHit };
     } 
     else {
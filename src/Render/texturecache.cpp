@@ -0,0 +1,387 @@
+#include <RayFlow/Render/texturecache.h>
+#include <RayFlow/Render/mipmap.h>
+#include <RayFlow/Util/bitmap.h>
+#include <RayFlow/Util/parallel.h>
+
+#include <stb_image/stb_image.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace rayflow {
+
+namespace {
+
+// tiled file layout: magic, version, tile size, level count, the resolution of every level and then the
+// tiles of every level in row major order, each TileSize^2 half RGB texels with edge tiles padded
+constexpr char TiledFileMagic[4] = { 'R', 'F', 'T', 'X' };
+constexpr int32_t TiledFileVersion = 1;
+
+// a cache allocated where a destroyed one was still gets a new generation
+std::atomic<uint64_t> nextCacheGeneration{ 1 };
+
+}
+
+TextureCache::TextureCache(size_t memoryBudget, const std::string& directory) :
+    mMemoryBudget_(std::max(memoryBudget, sizeof(Tile) * 64)),
+    mDirectory_(directory),
+    mGeneration_(nextCacheGeneration.fetch_add(1, std::memory_order_relaxed)) {
+
+}
+
+TextureCache::~TextureCache() {
+    for (Tile* tile : mResidentTiles_) {
+        delete tile;
+    }
+    for (Tile* tile : mRetiredTiles_) {
+        delete tile;
+    }
+}
+
+int TextureCache::AddTexture(const std::string& filename) {
+    Point2i resolution;
+    int channelCount;
+
+    if (!stbi_info(filename.c_str(), &resolution.x, &resolution.y, &channelCount)) {
+        std::cout << "ERROR::Failed to read texture [ " << filename << " ]\n";
+        return -1;
+    }
+
+    auto texture = std::make_unique<Texture>();
+    texture->filename = filename;
+
+    if (mDirectory_.empty()) {
+        texture->tiledFilename = filename + ".rftx";
+    }
+    else {
+        // the path hash keeps images with the same name apart
+        std::ostringstream name;
+        name << mDirectory_ << "/" << std::filesystem::path(filename).stem().string() << "_"
+             << std::hex << std::setw(16) << std::setfill('0') << std::hash<std::string>()(filename) << ".rftx";
+        texture->tiledFilename = name.str();
+    }
+
+    texture->levelResolutions = MIPMap::PyramidResolutions(resolution);
+
+    int tileCount = 0;
+    for (const Point2i& levelResolution : texture->levelResolutions) {
+        Point2i tiles((levelResolution.x + TileSize - 1) / TileSize, (levelResolution.y + TileSize - 1) / TileSize);
+        texture->levelTileCounts.push_back(tiles);
+        texture->levelTileOffsets.push_back(tileCount);
+        tileCount += tiles.x * tiles.y;
+    }
+
+    texture->tiles = std::make_unique<std::atomic<Tile*>[]>(tileCount);
+    for (int i = 0; i < tileCount; ++i) {
+        texture->tiles[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    mTextures_.push_back(std::move(texture));
+    return int(mTextures_.size()) - 1;
+}
+
+Spectrum TextureCache::Texel(int textureId, int level, const Point2i& st) const {
+    Texture& texture = *mTextures_[textureId];
+    ThreadRecord& record = LocalRecord();
+    record.lookups.store(record.lookups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    Point2i tileCounts = texture.levelTileCounts[level];
+    int tileIndex = texture.levelTileOffsets[level] + (st.y / TileSize) * tileCounts.x + st.x / TileSize;
+    std::atomic<Tile*>& slot = texture.tiles[tileIndex];
+
+    // the hazard pointer is published before the slot is read again, a tile evicted in between is seen as
+    // missing, a tile still in the slot afterwards is not freed until the hazard is cleared
+    Tile* tile = nullptr;
+    for (;;) {
+        tile = slot.load(std::memory_order_acquire);
+
+        if (tile == nullptr) {
+            LoadTile(texture, tileIndex, record);
+            continue;
+        }
+
+        record.hazard.store(tile, std::memory_order_seq_cst);
+        if (slot.load(std::memory_order_seq_cst) == tile) {
+            break;
+        }
+    }
+
+    if (!tile->referenced.load(std::memory_order_relaxed)) {
+        tile->referenced.store(true, std::memory_order_relaxed);
+    }
+
+    const Half* texel = tile->texels + 3 * ((st.y % TileSize) * TileSize + st.x % TileSize);
+    Float rgb[3] = { Float(texel[0]), Float(texel[1]), Float(texel[2]) };
+    record.hazard.store(nullptr, std::memory_order_release);
+
+    return Spectrum(rgb);
+}
+
+void TextureCache::PrintStatistics() const {
+    std::lock_guard<std::mutex> lock(mClockMutex_);
+    uint64_t lookups = 0;
+    uint64_t misses = 0;
+
+    for (const auto& record : mThreadRecords_) {
+        lookups += record->lookups.load(std::memory_order_relaxed);
+        misses += record->misses.load(std::memory_order_relaxed);
+    }
+
+    Float hitRate = lookups > 0 ? 100.0f * Float(lookups - misses) / Float(lookups) : 0;
+    printf("Texture cache: %llu lookups, %.2f%% hits, %llu tile misses, %llu evictions, peak %.1f MB of %.1f MB\n",
+           (unsigned long long)lookups, hitRate, (unsigned long long)misses, (unsigned long long)mEvictions_,
+           mPeakBytes_ / 1048576.0, mMemoryBudget_ / 1048576.0);
+}
+
+TextureCache::ThreadRecord& TextureCache::LocalRecord() const {
+    thread_local const TextureCache* owner = nullptr;
+    thread_local uint64_t ownerGeneration = 0;
+    thread_local ThreadRecord* record = nullptr;
+
+    // the address alone may belong to a cache that has been destroyed since
+    if (owner != this || ownerGeneration != mGeneration_) {
+        std::lock_guard<std::mutex> lock(mClockMutex_);
+        mThreadRecords_.push_back(std::make_unique<ThreadRecord>());
+        record = mThreadRecords_.back().get();
+        owner = this;
+        ownerGeneration = mGeneration_;
+    }
+
+    return *record;
+}
+
+void TextureCache::LoadTile(Texture& texture, int tileIndex, ThreadRecord& record) const {
+    std::lock_guard<std::mutex> textureLock(texture.mutex);
+    std::atomic<Tile*>& slot = texture.tiles[tileIndex];
+
+    // another thread read the tile while this one waited
+    if (slot.load(std::memory_order_acquire) != nullptr) {
+        return;
+    }
+
+    if (!texture.opened) {
+        OpenTexture(texture);
+    }
+
+    Tile* tile = new Tile;
+    tile->slot = &slot;
+
+    if (texture.file.is_open()) {
+        texture.file.seekg(texture.dataOffset + std::streamoff(tileIndex) * std::streamoff(sizeof(tile->texels)));
+        texture.file.read(reinterpret_cast<char*>(tile->texels), sizeof(tile->texels));
+    }
+    if (!texture.file.is_open() || !texture.file) {
+        texture.file.clear();
+        std::fill_n(tile->texels, TileSize * TileSize * 3, Half(0.f));
+    }
+
+    record.misses.store(record.misses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> clockLock(mClockMutex_);
+    while (mResidentBytes_ + sizeof(Tile) > mMemoryBudget_ && EvictTile()) {}
+    ReclaimTiles();
+
+    mResidentTiles_.push_back(tile);
+    mResidentBytes_ += sizeof(Tile);
+    mPeakBytes_ = std::max(mPeakBytes_, mResidentBytes_);
+    slot.store(tile, std::memory_order_release);
+}
+
+void TextureCache::OpenTexture(Texture& texture) const {
+    texture.opened = true;
+
+    if (ReadHeader(texture)) {
+        return;
+    }
+
+    texture.file.close();
+    texture.file.clear();
+
+    if (!ConvertTexture(texture) || !ReadHeader(texture)) {
+        std::cout << "ERROR::Failed to create tiled texture [ " << texture.tiledFilename << " ]\n";
+        texture.file.close();
+    }
+}
+
+bool TextureCache::ReadHeader(Texture& texture) const {
+    std::error_code sourceError, tiledError;
+    auto sourceTime = std::filesystem::last_write_time(texture.filename, sourceError);
+    auto tiledTime = std::filesystem::last_write_time(texture.tiledFilename, tiledError);
+
+    // a tiled file older than its image is converted again
+    if (sourceError || tiledError || tiledTime < sourceTime) {
+        return false;
+    }
+
+    texture.file.open(texture.tiledFilename, std::ios::binary);
+
+    char magic[4];
+    int32_t header[3];
+    texture.file.read(magic, sizeof(magic));
+    texture.file.read(reinterpret_cast<char*>(header), sizeof(header));
+
+    if (!texture.file || memcmp(magic, TiledFileMagic, sizeof(magic)) != 0 || header[0] != TiledFileVersion ||
+        header[1] != TileSize || header[2] != int32_t(texture.levelResolutions.size())) {
+        return false;
+    }
+
+    for (const Point2i& resolution : texture.levelResolutions) {
+        int32_t levelResolution[2];
+        texture.file.read(reinterpret_cast<char*>(levelResolution), sizeof(levelResolution));
+
+        if (!texture.file || levelResolution[0] != resolution.x || levelResolution[1] != resolution.y) {
+            return false;
+        }
+    }
+
+    texture.dataOffset = texture.file.tellg();
+    return true;
+}
+
+bool TextureCache::ConvertTexture(const Texture& texture) const {
+    // only the level being written is kept, as half RGB, the next one is box filtered from it
+    Point2i resolution = texture.levelResolutions[0];
+    std::vector<Half> level(3 * resolution.x * resolution.y);
+    {
+        BitMap image(texture.filename, false);
+        Scheduler::Parallel1D(resolution.y, 16,
+            [&](int begin, int end) {
+                for (int y = begin; y < end; ++y) {
+                    for (int x = 0; x < resolution.x; ++x) {
+                        Spectrum texel = image.GetPixel<Spectrum>(Point2i(x, y));
+                        for (int c = 0; c < 3; ++c) {
+                            level[3 * (y * resolution.x + x) + c] = Half(texel[c]);
+                        }
+                    }
+                }
+            }
+        );
+    }
+
+    // written under a temporary name, a partly written file is never picked up by another render
+    std::string temporaryFilename = texture.tiledFilename + ".tmp";
+    std::ofstream file(temporaryFilename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    int32_t header[3] = { TiledFileVersion, TileSize, int32_t(texture.levelResolutions.size()) };
+    file.write(TiledFileMagic, sizeof(TiledFileMagic));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    for (const Point2i& resolution : texture.levelResolutions) {
+        int32_t levelResolution[2] = { resolution.x, resolution.y };
+        file.write(reinterpret_cast<const char*>(levelResolution), sizeof(levelResolution));
+    }
+
+    std::vector<Half> texels(TileSize * TileSize * 3);
+    for (size_t l = 0; l < texture.levelResolutions.size(); ++l) {
+        resolution = texture.levelResolutions[l];
+        Point2i tileCounts = texture.levelTileCounts[l];
+
+        for (int ty = 0; ty < tileCounts.y; ++ty) {
+            for (int tx = 0; tx < tileCounts.x; ++tx) {
+                for (int y = 0; y < TileSize; ++y) {
+                    for (int x = 0; x < TileSize; ++x) {
+                        Point2i p(std::min(tx * TileSize + x, resolution.x - 1), std::min(ty * TileSize + y, resolution.y - 1));
+                        std::copy_n(&level[3 * (p.y * resolution.x + p.x)], 3, &texels[3 * (y * TileSize + x)]);
+                    }
+                }
+
+                file.write(reinterpret_cast<const char*>(texels.data()), texels.size() * sizeof(Half));
+            }
+        }
+
+        if (l + 1 == texture.levelResolutions.size()) {
+            break;
+        }
+
+        // a texel averages the 2x2 texels above it, an odd last row or column is dropped
+        Point2i below = texture.levelResolutions[l + 1];
+        std::vector<Half> next(3 * below.x * below.y);
+        Scheduler::Parallel1D(below.y, 16,
+            [&](int begin, int end) {
+                for (int y = begin; y < end; ++y) {
+                    int y0 = 2 * y * resolution.x;
+                    int y1 = std::min(2 * y + 1, resolution.y - 1) * resolution.x;
+                    for (int x = 0; x < below.x; ++x) {
+                        int x0 = 2 * x;
+                        int x1 = std::min(2 * x + 1, resolution.x - 1);
+                        for (int c = 0; c < 3; ++c) {
+                            float sum = float(level[3 * (y0 + x0) + c]) + float(level[3 * (y0 + x1) + c]) +
+                                        float(level[3 * (y1 + x0) + c]) + float(level[3 * (y1 + x1) + c]);
+                            next[3 * (y * below.x + x) + c] = Half(sum * 0.25f);
+                        }
+                    }
+                }
+            }
+        );
+        level = std::move(next);
+    }
+
+    file.close();
+    if (!file) {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryFilename, texture.tiledFilename, error);
+    return !error;
+}
+
+bool TextureCache::EvictTile() const {
+    if (mResidentTiles_.empty()) {
+        return false;
+    }
+
+    // tiles hit since the hand last passed get a second chance
+    for (;;) {
+        if (mClockHand_ >= mResidentTiles_.size()) {
+            mClockHand_ = 0;
+        }
+
+        Tile* tile = mResidentTiles_[mClockHand_];
+        if (tile->referenced.exchange(false, std::memory_order_relaxed)) {
+            ++mClockHand_;
+            continue;
+        }
+
+        tile->slot->store(nullptr, std::memory_order_seq_cst);
+        mResidentTiles_[mClockHand_] = mResidentTiles_.back();
+        mResidentTiles_.pop_back();
+        mResidentBytes_ -= sizeof(Tile);
+        mRetiredTiles_.push_back(tile);
+        ++mEvictions_;
+        return true;
+    }
+}
+
+void TextureCache::ReclaimTiles() const {
+    auto isReferenced = [&](const Tile* tile) {
+        for (const auto& record : mThreadRecords_) {
+            if (record->hazard.load(std::memory_order_seq_cst) == tile) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    size_t kept = 0;
+    for (Tile* tile : mRetiredTiles_) {
+        if (isReferenced(tile)) {
+            mRetiredTiles_[kept++] = tile;
+        }
+        else {
+            delete tile;
+        }
+    }
+    mRetiredTiles_.resize(kept);
+}
+
+}
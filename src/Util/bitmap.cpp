@@ -2,12 +2,35 @@
 #include <stb_image/stb_image.h>
 #include <stb_image/stb_image_write.h>
 
+#include <RayFlow/Util/exr.h>
+
+#include <array>
+
 namespace rayflow {
 BitMap::BitMap(const std::string& filename, bool gamma) : 
     mGamma_(gamma) {
     Read(filename);
 }
 
+uint8_t BitMap::QuantizeGamma(float value) const {
+    // thresholds[k] is the smallest linear value with code k
+    static const std::array<float, 256> thresholds = [this]() {
+        std::array<float, 256> t;
+        t[0] = -Infinity;
+        for (int k = 1; k < 256; ++k) {
+            t[k] = InverseGammaCorrect(k / 255.f);
+        }
+        return t;
+    }();
+
+    int code = 0;
+    for (int step = 128; step > 0; step >>= 1) {
+        code += value >= thresholds[code + step] ? step : 0;
+    }
+
+    return uint8_t(code);
+}
+
 void BitMap::SetPixel(const Point2i& pos, const Spectrum& value) {
     int channels = GetChannelsCount();
     int offset = (pos.y * mResolution_.x + pos.x) * channels;
@@ -15,7 +38,7 @@ void BitMap::SetPixel(const Point2i& pos, const Spectrum& value) {
     if (mComponentFormat_ == BitMapComponentFormat::EUInt8) {
         uint8_t* data = GetUInt8Data();
         for (int i = 0; i < channels; ++i) {
-            data[offset + i] = static_cast<uint8_t>(Clamp(GammaCorrect((float)value[i]) * 255, 0, 255));
+            data[offset + i] = QuantizeGamma((float)value[i]);
         }
     }
     else if (mComponentFormat_ == BitMapComponentFormat::EFloat16) {
@@ -47,7 +70,8 @@ void BitMap::Read(const std::string& filename) {
         mComponentFormat_ = BitMapComponentFormat::EFloat16;
 
         int pixelCount = GetPixelCount();
-        Half* buffer = new Half[pixelCount * mChannelCount_];
+        mOwnedData_ = std::make_unique<Half[]>(pixelCount * mChannelCount_);
+        Half* buffer = mOwnedData_.get();
 
         for (int i = 0; i < pixelCount; ++i) {
             int offset = i * mChannelCount_;
@@ -68,6 +92,48 @@ void BitMap::Write(const std::string& filename) const {
     if (fileEnd == "png") {
         WritePNG(filename);
     }
+    else if (fileEnd == "pfm") {
+        WritePFM(filename);
+    }
+    else if (fileEnd == "exr") {
+        WriteOpenEXR(filename);
+    }
+}
+
+void BitMap::WriteOpenEXR(const std::string& filename) const {
+    std::vector<std::string> channels;
+    if (mChannelCount_ == 1) {
+        channels = { "Y" };
+    }
+    else {
+        channels = { "R", "G", "B" };
+    }
+
+    EXRWriter writer(filename, mResolution_, channels, EXRPixelType::EHalf);
+    std::vector<float> row(size_t(mResolution_.x) * mChannelCount_);
+
+    for (int y = 0; y < mResolution_.y && writer.IsOpen(); ++y) {
+        for (int i = 0; i < mResolution_.x * mChannelCount_; ++i) {
+            size_t offset = size_t(y) * mResolution_.x * mChannelCount_ + i;
+
+            switch (mComponentFormat_) {
+                case BitMapComponentFormat::EUInt8 :
+                    row[i] = mGamma_ ? InverseGammaCorrect(mData_[offset] / 255.f) : mData_[offset] / 255.f;
+                    break;
+                case BitMapComponentFormat::EFloat16 :
+                    row[i] = float(GetFloat16Data()[offset]);
+                    break;
+                case BitMapComponentFormat::EFloat32 :
+                    row[i] = GetFloat32Data()[offset];
+                    break;
+                case BitMapComponentFormat::EFloat64 :
+                    row[i] = float(GetFloat64Data()[offset]);
+                    break;
+            }
+        }
+
+        writer.WriteScanlines(1, row.data());
+    }
 }
 
 void BitMap::WritePNG(const std::string& filename) const {
@@ -99,4 +165,28 @@ void BitMap::WritePNG(const std::string& filename) const {
     }
 }
 
+void BitMap::WritePFM(const std::string& filename) const {
+    if (mComponentFormat_ != BitMapComponentFormat::EFloat32 || (mChannelCount_ != 1 && mChannelCount_ != 3)) {
+        std::cout << "ERROR::PFM needs 1 or 3 float channels [ " << filename << " ]\n";
+        return;
+    }
+
+    FILE* file = fopen(filename.c_str(), "wb");
+
+    if (file == nullptr) {
+        std::cout << "ERROR::Failed to open [ " << filename << " ]\n";
+        return;
+    }
+
+    // a negative scale marks little endian data, scanlines go from bottom to top
+    fprintf(file, "%s\n%d %d\n-1.0\n", mChannelCount_ == 3 ? "PF" : "Pf", mResolution_.x, mResolution_.y);
+
+    const float* data = GetFloat32Data();
+    for (int y = mResolution_.y - 1; y >= 0; --y) {
+        fwrite(data + y * mResolution_.x * mChannelCount_, sizeof(float), mResolution_.x * mChannelCount_, file);
+    }
+
+    fclose(file);
+}
+
 }
\ No newline at end of file
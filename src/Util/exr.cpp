@@ -0,0 +1,175 @@
+#include <RayFlow/Util/exr.h>
+#include <RayFlow/Util/half.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+namespace rayflow {
+
+namespace {
+
+// https://openexr.com/en/latest/OpenEXRFileLayout.html, all values are little endian
+void WriteBytes(FILE* file, const void* data, size_t size) {
+    fwrite(data, 1, size, file);
+}
+
+// long is 32 bits on Windows, images past 2 GB need the 64 bit file positions
+int64_t Tell(FILE* file) {
+#ifdef _MSC_VER
+    return _ftelli64(file);
+#else
+    return int64_t(ftello(file));
+#endif
+}
+
+int Seek(FILE* file, int64_t offset) {
+#ifdef _MSC_VER
+    return _fseeki64(file, offset, SEEK_SET);
+#else
+    return fseeko(file, off_t(offset), SEEK_SET);
+#endif
+}
+
+template <typename T>
+void WriteValue(FILE* file, T value) {
+    WriteBytes(file, &value, sizeof(T));
+}
+
+void WriteAttribute(FILE* file, const char* name, const char* type, int32_t size) {
+    WriteBytes(file, name, strlen(name) + 1);
+    WriteBytes(file, type, strlen(type) + 1);
+    WriteValue(file, size);
+}
+
+}
+
+EXRWriter::EXRWriter(const std::string& filename, const Point2i& resolution,
+                     const std::vector<std::string>& channels, EXRPixelType pixelType) :
+    mResolution_(resolution),
+    mPixelType_(pixelType),
+    mChannelOrder_(channels.size()),
+    mOffsets_(resolution.y) {
+    mFile_ = fopen(filename.c_str(), "wb");
+
+    if (mFile_ == nullptr) {
+        std::cout << "ERROR::Failed to open [ " << filename << " ]\n";
+        return;
+    }
+
+    std::iota(mChannelOrder_.begin(), mChannelOrder_.end(), 0);
+    std::sort(mChannelOrder_.begin(), mChannelOrder_.end(),
+              [&](int a, int b) { return channels[a] < channels[b]; });
+
+    int componentBytes = mPixelType_ == EXRPixelType::EHalf ? 2 : 4;
+    mScanline_.resize(size_t(mResolution_.x) * channels.size() * componentBytes);
+
+    // magic number and version 2, single part scanline file
+    WriteValue<int32_t>(mFile_, 20000630);
+    WriteValue<int32_t>(mFile_, 2);
+
+    int32_t channelListSize = 1;
+    for (const std::string& channel : channels) {
+        channelListSize += int32_t(channel.size()) + 1 + 16;
+    }
+
+    WriteAttribute(mFile_, "channels", "chlist", channelListSize);
+    for (int c : mChannelOrder_) {
+        WriteBytes(mFile_, channels[c].c_str(), channels[c].size() + 1);
+        WriteValue<int32_t>(mFile_, int32_t(mPixelType_));
+        // pLinear and three reserved bytes
+        WriteValue<int32_t>(mFile_, 0);
+        WriteValue<int32_t>(mFile_, 1);
+        WriteValue<int32_t>(mFile_, 1);
+    }
+    WriteValue<uint8_t>(mFile_, 0);
+
+    WriteAttribute(mFile_, "compression", "compression", 1);
+    WriteValue<uint8_t>(mFile_, 0);
+
+    int32_t window[4] = { 0, 0, mResolution_.x - 1, mResolution_.y - 1 };
+    WriteAttribute(mFile_, "dataWindow", "box2i", 16);
+    WriteBytes(mFile_, window, sizeof(window));
+    WriteAttribute(mFile_, "displayWindow", "box2i", 16);
+    WriteBytes(mFile_, window, sizeof(window));
+
+    // increasing y
+    WriteAttribute(mFile_, "lineOrder", "lineOrder", 1);
+    WriteValue<uint8_t>(mFile_, 0);
+
+    WriteAttribute(mFile_, "pixelAspectRatio", "float", 4);
+    WriteValue<float>(mFile_, 1);
+
+    WriteAttribute(mFile_, "screenWindowCenter", "v2f", 8);
+    WriteValue<float>(mFile_, 0);
+    WriteValue<float>(mFile_, 0);
+
+    WriteAttribute(mFile_, "screenWindowWidth", "float", 4);
+    WriteValue<float>(mFile_, 1);
+
+    WriteValue<uint8_t>(mFile_, 0);
+
+    // every scanline is a block of its own, the table is rewritten on Close
+    mOffsetTablePosition_ = Tell(mFile_);
+    WriteBytes(mFile_, mOffsets_.data(), mOffsets_.size() * sizeof(uint64_t));
+}
+
+EXRWriter::~EXRWriter() {
+    Close();
+}
+
+void EXRWriter::WriteScanlines(int rowCount, const float* data) {
+    if (!mFile_) {
+        return;
+    }
+
+    static_assert(sizeof(Half) == 2, "EXR half channels are 16 bit");
+    int channelCount = int(mChannelOrder_.size());
+    int width = mResolution_.x;
+    rowCount = std::min(rowCount, mResolution_.y - mNextRow_);
+
+    for (int row = 0; row < rowCount; ++row, ++mNextRow_) {
+        const float* pixels = data + size_t(row) * width * channelCount;
+
+        // scanline data is stored channel by channel
+        for (int i = 0; i < channelCount; ++i) {
+            int c = mChannelOrder_[i];
+
+            if (mPixelType_ == EXRPixelType::EHalf) {
+                Half* dest = reinterpret_cast<Half*>(mScanline_.data()) + size_t(i) * width;
+                for (int x = 0; x < width; ++x) {
+                    dest[x] = Half(pixels[x * channelCount + c]);
+                }
+            }
+            else {
+                float* dest = reinterpret_cast<float*>(mScanline_.data()) + size_t(i) * width;
+                for (int x = 0; x < width; ++x) {
+                    dest[x] = pixels[x * channelCount + c];
+                }
+            }
+        }
+
+        mOffsets_[mNextRow_] = uint64_t(Tell(mFile_));
+        WriteValue<int32_t>(mFile_, mNextRow_);
+        WriteValue<int32_t>(mFile_, int32_t(mScanline_.size()));
+        WriteBytes(mFile_, mScanline_.data(), mScanline_.size());
+    }
+}
+
+void EXRWriter::Close() {
+    if (!mFile_) {
+        return;
+    }
+
+    if (mNextRow_ < mResolution_.y) {
+        std::cout << "ERROR::EXR closed after " << mNextRow_ << " of " << mResolution_.y << " scanlines\n";
+    }
+
+    Seek(mFile_, mOffsetTablePosition_);
+    WriteBytes(mFile_, mOffsets_.data(), mOffsets_.size() * sizeof(uint64_t));
+    fclose(mFile_);
+    mFile_ = nullptr;
+}
+
+}
@@ -1,11 +1,32 @@
 ﻿#include <RayFlow/Engine/engine.h>
 
 #include <iostream>
+#include <string>
 
-int main()
+// usage: RayFlow [scene.xml] [--integrator name]
+int main(int argc, char** argv)
 {
+	std::string filename = "C:/FlowSource/code/FlowLab/RayFlow/resources/cornell-box-monster/cornell-box-disneydiffuse.xml";
+	std::string integratorType;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--integrator" && i + 1 < argc)
+		{
+			integratorType = argv[++i];
+		}
+		else
+		{
+			filename = arg;
+		}
+	}
+
 	rayflow::RayFlowEngine engine;
-	engine.Init("C:/FlowSource/code/FlowLab/RayFlow/resources/cornell-box-monster/cornell-box-disneydiffuse.xml");
+	if (!engine.Init(filename, integratorType))
+	{
+		return 1;
+	}
 	engine.Render();
 	return 0;
 }